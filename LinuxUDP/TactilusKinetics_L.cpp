@@ -0,0 +1,246 @@
+#include "TactilusKinetics_L.h"
+
+#if !defined(TACTILUS_KINETICS_SCALAR)
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define KINETICS_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KINETICS_SSE2
+#include <emmintrin.h>
+#endif
+#endif
+
+namespace tactilus_udp_linux
+{
+	namespace
+	{
+		// TactilusUDP's area table as it evaluates: its 2/3, 1/2, 1/3 and 1/4 are integer divisions, so the sender
+		// counts the partial pads around the edge as 0, and the whole pads as PADLENGTH * PADWIDTH
+		const double senderpads[PADROWS][PADCOLS] = { { 0, 0, 0, 0, 0, 1, 0, 0 },
+													  { 0, 0, 0, 1, 1, 1, 1, 0 },
+													  { 0, 0, 1, 1, 1, 1, 1, 0 },
+													  { 0, 1, 1, 1, 1, 1, 1, 1 },
+													  { 0, 1, 1, 1, 1, 1, 1, 1 },
+													  { 0, 1, 1, 1, 1, 1, 1, 1 },
+													  { 1, 1, 1, 1, 1, 1, 1, 0 },
+													  { 1, 1, 1, 1, 1, 1, 1, 0 },
+													  { 0, 1, 1, 1, 1, 1, 0, 0 },
+													  { 0, 1, 1, 1, 1, 1, 0, 0 },
+													  { 0, 1, 1, 1, 1, 1, 0, 0 },
+													  { 0, 1, 1, 1, 1, 1, 0, 0 },
+													  { 0, 1, 1, 1, 1, 1, 0, 0 },
+													  { 0, 1, 1, 1, 1, 0, 0, 0 },
+													  { 0, 1, 1, 1, 1, 0, 0, 0 },
+													  { 0, 0, 1, 1, 0, 0, 0, 0 } };
+
+		void sweepScalar(const float* kPa, const KineticsWeights& w, float contactkPa, FrameKinetics& k)
+		{
+			float force = 0, sumfx = 0, sumfy = 0, front = 0, contact = 0, peak = 0;
+			for (unsigned int i = 0; i < NUMPADS; ++i)
+			{
+				force = force + w.force[i] * kPa[i];
+				sumfx = sumfx + w.x[i] * kPa[i];
+				sumfy = sumfy + w.y[i] * kPa[i];
+				front = front + w.front[i] * kPa[i];
+				if (kPa[i] > contactkPa) {
+					contact = contact + w.area[i];
+				}
+				if (kPa[i] > peak) {
+					peak = kPa[i];
+				}
+			}
+			k.force = force;
+			k.sumfx = sumfx;
+			k.sumfy = sumfy;
+			k.frontforce = front;
+			k.backforce = force - front;
+			k.contactarea = contact;
+			k.peakkPa = peak;
+		}
+
+#if defined(KINETICS_SSE2)
+		float sum4(__m128 v)
+		{
+			__m128 pairs = _mm_add_ps(v, _mm_movehl_ps(v, v));
+			return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+		}
+
+		float max4(__m128 v)
+		{
+			__m128 pairs = _mm_max_ps(v, _mm_movehl_ps(v, v));
+			return _mm_cvtss_f32(_mm_max_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+		}
+
+		void sweepSSE2(const float* kPa, const KineticsWeights& w, float contactkPa, FrameKinetics& k)
+		{
+			__m128 force = _mm_setzero_ps();
+			__m128 sumfx = _mm_setzero_ps();
+			__m128 sumfy = _mm_setzero_ps();
+			__m128 front = _mm_setzero_ps();
+			__m128 contact = _mm_setzero_ps();
+			__m128 peak = _mm_setzero_ps();
+			const __m128 threshold = _mm_set1_ps(contactkPa);
+			for (unsigned int i = 0; i < NUMPADS; i += 4)
+			{
+				__m128 p = _mm_loadu_ps(kPa + i);
+				force = _mm_add_ps(force, _mm_mul_ps(_mm_load_ps(w.force + i), p));
+				sumfx = _mm_add_ps(sumfx, _mm_mul_ps(_mm_load_ps(w.x + i), p));
+				sumfy = _mm_add_ps(sumfy, _mm_mul_ps(_mm_load_ps(w.y + i), p));
+				front = _mm_add_ps(front, _mm_mul_ps(_mm_load_ps(w.front + i), p));
+				contact = _mm_add_ps(contact, _mm_and_ps(_mm_cmpgt_ps(p, threshold), _mm_load_ps(w.area + i)));
+				peak = _mm_max_ps(peak, p);
+			}
+			k.force = sum4(force);
+			k.sumfx = sum4(sumfx);
+			k.sumfy = sum4(sumfy);
+			k.frontforce = sum4(front);
+			k.backforce = k.force - k.frontforce;
+			k.contactarea = sum4(contact);
+			k.peakkPa = max4(peak);
+		}
+#endif
+
+#if defined(KINETICS_NEON)
+		// Without vaddvq/vmaxvq, which ARMv7 (the BeagleBone) doesn't have
+		float sum4(float32x4_t v)
+		{
+			float32x2_t pairs = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+			return vget_lane_f32(vpadd_f32(pairs, pairs), 0);
+		}
+
+		float max4(float32x4_t v)
+		{
+			float32x2_t pairs = vmax_f32(vget_low_f32(v), vget_high_f32(v));
+			return vget_lane_f32(vpmax_f32(pairs, pairs), 0);
+		}
+
+		void sweepNEON(const float* kPa, const KineticsWeights& w, float contactkPa, FrameKinetics& k)
+		{
+			float32x4_t force = vdupq_n_f32(0);
+			float32x4_t sumfx = vdupq_n_f32(0);
+			float32x4_t sumfy = vdupq_n_f32(0);
+			float32x4_t front = vdupq_n_f32(0);
+			float32x4_t contact = vdupq_n_f32(0);
+			float32x4_t peak = vdupq_n_f32(0);
+			const float32x4_t threshold = vdupq_n_f32(contactkPa);
+			for (unsigned int i = 0; i < NUMPADS; i += 4)
+			{
+				float32x4_t p = vld1q_f32(kPa + i);
+				force = vmlaq_f32(force, vld1q_f32(w.force + i), p);
+				sumfx = vmlaq_f32(sumfx, vld1q_f32(w.x + i), p);
+				sumfy = vmlaq_f32(sumfy, vld1q_f32(w.y + i), p);
+				front = vmlaq_f32(front, vld1q_f32(w.front + i), p);
+				uint32x4_t above = vcgtq_f32(p, threshold);
+				contact = vaddq_f32(contact, vreinterpretq_f32_u32(vandq_u32(above, vreinterpretq_u32_f32(vld1q_f32(w.area + i)))));
+				peak = vmaxq_f32(peak, p);
+			}
+			k.force = sum4(force);
+			k.sumfx = sum4(sumfx);
+			k.sumfy = sum4(sumfy);
+			k.frontforce = sum4(front);
+			k.backforce = k.force - k.frontforce;
+			k.contactarea = sum4(contact);
+			k.peakkPa = max4(peak);
+		}
+#endif
+	}
+
+	float FrameKinetics::copx() const
+	{
+		return this->force == 0 ? 0 : this->sumfx / this->force;
+	}
+
+	float FrameKinetics::copy() const
+	{
+		return this->force == 0 ? 0 : this->sumfy / this->force;
+	}
+
+	float FrameKinetics::momentyat(float x1) const
+	{
+		return -(this->sumfx - x1 * this->force) / 1000.0f; // Divide by 1000 to get Nm
+	}
+
+	float FrameKinetics::momentxat(float y1) const
+	{
+		return (this->sumfy - y1 * this->force) / 1000.0f;
+	}
+
+	void FrameKinetics::moments(const RefPoint* points, unsigned int npoints, float* out) const
+	{
+		for (unsigned int i = 0; i < npoints; ++i)
+		{
+			out[2 * i] = this->momentyat(points[i].x);
+			out[2 * i + 1] = this->momentxat(points[i].y);
+		}
+	}
+
+	KineticsEngine::KineticsEngine() : contactkPa(0)
+	{
+		double areas[PADROWS][PADCOLS];
+		for (unsigned int r = 0; r < PADROWS; ++r)
+		{
+			for (unsigned int c = 0; c < PADCOLS; ++c)
+			{
+				areas[r][c] = senderpads[r][c] * PADLENGTH * PADWIDTH;
+			}
+		}
+		this->setareas(areas);
+	}
+
+	KineticsEngine::KineticsEngine(const double areas[PADROWS][PADCOLS]) : contactkPa(0)
+	{
+		this->setareas(areas);
+	}
+
+	void KineticsEngine::setareas(const double areas[PADROWS][PADCOLS])
+	{
+		for (unsigned int r = 0; r < PADROWS; ++r)
+		{
+			for (unsigned int c = 0; c < PADCOLS; ++c)
+			{
+				unsigned int i = r * PADCOLS + c;
+				// Pad centres as in KineticsResult::momentyat/momentxat: x counts down from the front edge, y from the inside edge
+				double x = INSOLELENGTH - PADLENGTH * (r + 0.5);
+				double y = INSOLEWIDTH - PADWIDTH * (c + 0.5);
+				double n = areas[r][c] / 1000.0; // mm^2 * kPa gives mN
+				this->w.force[i] = (float)n;
+				this->w.x[i] = (float)(n * x);
+				this->w.y[i] = (float)(n * y);
+				this->w.front[i] = r < PADROWS / 2 ? (float)n : 0;
+				this->w.area[i] = (float)areas[r][c];
+			}
+		}
+	}
+
+	void KineticsEngine::setcontact(float kPa)
+	{
+		this->contactkPa = kPa;
+	}
+
+	void KineticsEngine::compute(const float* kPa, FrameKinetics& k) const
+	{
+#if defined(KINETICS_NEON)
+		sweepNEON(kPa, this->w, this->contactkPa, k);
+#elif defined(KINETICS_SSE2)
+		sweepSSE2(kPa, this->w, this->contactkPa, k);
+#else
+		sweepScalar(kPa, this->w, this->contactkPa, k);
+#endif
+	}
+
+	void KineticsEngine::computeScalar(const float* kPa, FrameKinetics& k) const
+	{
+		sweepScalar(kPa, this->w, this->contactkPa, k);
+	}
+
+	const char* KineticsEngine::backend() const
+	{
+#if defined(KINETICS_NEON)
+		return "neon";
+#elif defined(KINETICS_SSE2)
+		return "sse2";
+#else
+		return "scalar";
+#endif
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "TactilusKinetics.h"
+
+// Build with TACTILUS_KINETICS_SCALAR defined to leave out the SSE2/NEON kernels
+
+namespace tactilus_udp_linux
+{
+	// Point moments are taken about [mm], x from back to front and y from inside to outside of the foot like the sender's x1/y1
+	struct RefPoint
+	{
+		float x;
+		float y;
+	};
+
+	// What one sweep over a frame gives, moments about any point follow from it without going over the frame again
+	struct FrameKinetics
+	{
+		float force; // total force [N]
+		float sumfx; // sum of pad forces times the x of their centres [N mm]
+		float sumfy; // sum of pad forces times the y of their centres [N mm]
+		float frontforce; // force on the front 64 pads (rows 0-7) [N]
+		float backforce; // force on the back 64 pads (rows 8-15) [N]
+		float contactarea; // area of the pads above the engine's contact pressure [mm^2]
+		float peakkPa; // highest pad pressure [kPa]
+
+		float copx() const;
+		//  Center of pressure along x [mm], 0 without force
+
+		float copy() const;
+		//  Center of pressure along y [mm], 0 without force
+
+		float momentyat(float x1) const;
+		//  Moment about the y axis at x1 [Nm], same sign as the sender's momenty
+
+		float momentxat(float y1) const;
+		//  Moment about the x axis at y1 [Nm], same sign as the sender's momentx
+
+		void moments(const RefPoint* points, unsigned int npoints, float* out) const;
+		//  out[2i] is the moment about y at points[i].x and out[2i+1] the one about x at points[i].y [Nm]
+	};
+
+	// Per pad weights, so a sweep is a few multiply-adds per pad and nothing depends on the row or column
+	struct KineticsWeights
+	{
+		alignas(16) float force[NUMPADS]; // pad area / 1000, kPa to N
+		alignas(16) float x[NUMPADS]; // force times the x of the pad's centre
+		alignas(16) float y[NUMPADS]; // force times the y of the pad's centre
+		alignas(16) float front[NUMPADS]; // force on rows 0-7, 0 on the others
+		alignas(16) float area[NUMPADS]; // mm^2
+	};
+
+	// Force, CoP and moments of whole 16x8 pressure frames (from TactilusUDP_L::getmap()) on the receiving side,
+	// so the points moments are taken about can change, and be as many as wanted, without another handshake
+	class KineticsEngine
+	{
+	public:
+		KineticsEngine();
+		//  Pad areas as the sender's TactilusUDP has them, so forces and moments agree with what it sends
+
+		KineticsEngine(const double areas[PADROWS][PADCOLS]);
+		//  Other pad areas [mm^2], 0 for pads that don't count
+
+		void setcontact(float kPa);
+		//  Pads above kPa count towards contactarea (0 unless set)
+
+		void compute(const float* kPa, FrameKinetics& k) const;
+		//  One sweep over a frame of pressures [kPa], with the SSE2 or NEON kernel where this build has one
+
+		void computeScalar(const float* kPa, FrameKinetics& k) const;
+		//  Same without SIMD, kept to compare against
+
+		const char* backend() const;
+		//  Kernel compute() runs: "sse2", "neon" or "scalar"
+
+	private:
+		void setareas(const double areas[PADROWS][PADCOLS]);
+
+		KineticsWeights w;
+		float contactkPa;
+	};
+}
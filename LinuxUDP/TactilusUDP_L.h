@@ -8,8 +8,23 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+
+#include "TactilusPacket.h"
+#include "TactilusHistogram.h"
+#include "TactilusMap.h"
+#include "TactilusSession.h"
+#include "TactilusHandoff.h"
+#include "TactilusKinetics_L.h"
 
 #define BUFLEN 16384             //Max length of buffer
+#define MAXTEXTVALUES 256       //Most numbers the vector get* methods take from a text message
+#define DRAINBATCH 32            //Messages recvlatest() takes per recvmmsg() call
+#define DRAINSLOTLEN MAXMAPPACKETLEN //Longest message recvlatest() takes, anything longer is dropped
+#define RECEIVETHREADWAITMS 100  //Longest the receive thread sleeps on the socket before it looks whether to stop
 
 // Author:  Jehan Yang
 // Updated: 09/01/2021
@@ -19,12 +34,42 @@
 // V1.12 for getting forces and moments for two pressure sensors
 namespace tactilus_udp_linux
 {
+	// Counters recv() keeps over the binary packets it receives
+	struct PacketStats
+	{
+		unsigned long received;
+		unsigned long lost; // sequence numbers that were skipped over and haven't turned up since
+		unsigned long reordered; // arrived after a packet with a higher sequence number
+		unsigned long duplicate; // sequence number already seen
+	};
+
+	// One message as the receive thread decoded it, see TactilusUDP_L::startreceiving()
+	struct ReceivedSample
+	{
+		unsigned long received = 0; // messages the thread got up to this one, 0 while nothing arrived. Gaps are skipped samples
+		std::chrono::steady_clock::time_point arrival; // when the thread read it
+		std::chrono::steady_clock::time_point kernelarrival; // when the kernel received it, arrival - kernelarrival is how long it queued
+		bool binary = false; // a packet, otherwise comma separated text from an older sender and hdr is all 0
+		tactilus_udp::PacketHeader hdr;
+		int nvalues = 0; // in values, what getvalues() would have given
+		float values[MAXTEXTVALUES];
+		int mapsensors = -1; // what getmap() would have returned
+		float maps[MAXSENSORS * MAPPADS];
+		PacketStats stats = { 0, 0, 0, 0 }; // getstats() as of this message
+	};
+
 	class TactilusUDP_L
 	{
 	
 	public:
+	// Every constructor sleeps until a sender handshakes, and then answers it. A sender that is already streaming,
+	// to an earlier run of this program, is asked to handshake again. Nothing here exits the process
 	// Added constructor that can tell Windows how many sensors to initialize	
 	TactilusUDP_L(std::string src_serv, u_int src_port, double desired_x_pos, double desired_y_pos, std::string nsens);
+	// Same, nsens can be anything from 1 to MAXSENSORS, the packets then carry that many sensors
+	TactilusUDP_L(std::string src_serv, u_int src_port, double desired_x_pos, double desired_y_pos, u_int nsens);
+	// Same, plus comma separated key=value options for the sender, e.g. "filter=ema:0.3" or "filter1=none,filter2=savgol:9:2"
+	TactilusUDP_L(std::string src_serv, u_int src_port, double desired_x_pos, double desired_y_pos, u_int nsens, std::string options);
 	// Added constructor that has desired y_por for where to get moment about
 	TactilusUDP_L(std::string src_serv, u_int src_port, double desired_x_pos, double desired_y_pos);
 	// Initialize class with local port and local IP address
@@ -37,7 +82,57 @@ namespace tactilus_udp_linux
 	void send(std::string message);
 
 	// Writes to buf internal variable what we receive, repeats many times if necessary
+	// Also keeps the session going: answers a restarted sender's handshake and sends the heartbeats, so call it
+	// regularly. Returns -1 with errno EAGAIN if nothing arrived (or only something for the session), never exits
+	// Waits up to 1 ms for a message
 	int recv();
+
+	// recv() waiting up to max_wait, which can be any number of microseconds (0 only looks), rather than 1 ms
+	int recv(std::chrono::microseconds max_wait);
+
+	// Takes every message waiting on the socket, with one recvmmsg() call per DRAINBATCH of them, and leaves only the
+	// newest in buf for getpacket(), getmap() and the like. How many older ones it skipped goes to skipped (if not NULL)
+	// Doesn't wait. Returns the newest message's length, or -1 with errno EAGAIN if nothing arrived for the caller
+	// Use it instead of calling recv() until it returns -1 to catch up when the caller fell behind
+	int recvlatest(unsigned int* skipped);
+
+	// Values of a binary packet recvlatest() skipped, age 1 being the one just before the newest, as getpacket() does
+	// Goes back as far as the last DRAINBATCH messages, and only until the next recv() or recvlatest(). -1 if there's no such packet
+	int getolder(unsigned int age, tactilus_udp::PacketHeader& hdr, float* values, unsigned int maxvalues);
+
+	// getvalues() of the newest message after recvlatest(skipped), -1 if nothing arrived
+	int getlatest(float* values, unsigned int maxvalues, unsigned int* skipped);
+
+	// Starts a thread that sleeps on the socket, does what recv() does for each message and publishes it as a ReceivedSample,
+	// so the control loop doesn't wait on the network. From then on that thread owns the socket: recv(), recvlatest() and
+	// the get* methods that receive return -1 with errno EBUSY, use fetchsample() and getsample() instead. So do getmap() and
+	// getkinetics(), the sample has the maps. getstats(), getkernelarrival(), getreadtime(), getpacket() and getbuf() read what
+	// the thread overwrites and mean nothing while it runs, the sample's stats, kernelarrival, arrival, hdr and values take
+	// their place. The age histogram and getstate() can be read any time. False if it runs already
+	bool startreceiving();
+
+	// Stops the receive thread (the destructor does too), recv() and the rest work again
+	void stopreceiving();
+
+	// Whether the receive thread published a sample since the last call. Wait-free and without a system call
+	bool fetchsample();
+
+	// The newest sample as of the last fetchsample(), untouched until the next one. received is 0 until something arrived
+	const ReceivedSample& getsample() const;
+
+	// When the kernel received the last message recv() or recvlatest() read (SO_TIMESTAMPNS), on the steady clock
+	// getreadtime() minus this is how long it waited in the socket, e.g. while the caller slept. getreadtime() if the kernel didn't stamp it
+	// Not while the receive thread runs, ReceivedSample::kernelarrival is this for each sample
+	std::chrono::steady_clock::time_point getkernelarrival();
+
+	// When recv() or recvlatest() read the last message from the socket. Not while the receive thread runs, see ReceivedSample::arrival
+	std::chrono::steady_clock::time_point getreadtime();
+
+	// SESSION_STREAMING while packets arrive, SESSION_HANDSHAKING once they stopped for STREAMTIMEOUTMS
+	tactilus_udp::SessionState getstate();
+
+	// How many times a sender handshook with this object, more than 1 means it restarted in between
+	unsigned long gethandshakes();
 	
 	// Returns buffer that we received on
 	char* getbuf();
@@ -63,14 +158,125 @@ namespace tactilus_udp_linux
 	// Get force in N and moment in Nm at the same time, sensornum is either 1, 2, or *
 	std::vector<float> getforcemoment(std::string sensornum);
 
-	// Get force in N and moments in Nm at the same time, sensornum is either 1, 2, or *
+	// Every value of the next packet, sensornum is ignored (kept for older callers)
 	std::vector<float> getforcemoments(std::string sensornum);
 
+	// Values of fields (tactilus_udp::PacketField bits) from the next packet, sensor by sensor in increasing bit order
+	// sensornum is 1 ... N or * for every sensor. Fields the sender wasn't asked for in the handshake are left out
+	// The other get* methods are this for their quantities, {-1} if nothing arrived
+	std::vector<float> getfields(uint32_t fields, std::string sensornum);
+
+	// getfields() into the caller's array without allocating: up to maxvalues values, sensor 1 ... N or 0 for every sensor
+	// Returns how many it wrote, -1 if nothing arrived
+	int getfields(uint32_t fields, unsigned int sensor, float* values, unsigned int maxvalues);
+
+	// Every value of the next message, binary or text, into the caller's array without allocating, up to maxvalues of them
+	// Returns how many it wrote, -1 if nothing arrived
+	int getvalues(float* values, unsigned int maxvalues);
+
+	// Decodes the last binary packet recv() got into hdr and up to maxvalues floats, no string work involved
+	// Returns the number of floats in the packet, or -1 if the last message was not a binary packet
+	int getpacket(tactilus_udp::PacketHeader& hdr, float* values, unsigned int maxvalues);
+
+	// Pressure maps [kPa] of the last packet recv() got, if the sender was asked for them with "map=delta" or "map=key":
+	// MAPPADS (16 rows of 8) per sensor for up to maxsensors sensors. Returns the number of sensors, -1 if the last packet
+	// had no maps and -2 if its maps were deltas on top of a lost packet (they come back with the next keyframe)
+	// -1 with errno EBUSY while the receive thread runs, ReceivedSample::maps and mapsensors are this for each sample
+	int getmap(float* kPa, unsigned int maxsensors);
+
+	// Force, CoP and first moments of each sensor's map in the last packet, worked out here with the sender's pad areas,
+	// k[i].moments() then gives moments about as many points as needed. Returns what getmap() would, EBUSY included
+	int getkinetics(tactilus_udp_linux::FrameKinetics* k, unsigned int maxsensors);
+
+	// Received, lost, reordered and duplicate packet counts since construction or resetstats()
+	// Not while the receive thread runs, it counts on; ReceivedSample::stats is this as of each sample
+	PacketStats getstats();
+
+	// Age of each received sample in microseconds: its one-way delay from the sender's scan to recv() here,
+	// minus the smallest delay seen since resetstats(). The two clocks aren't synchronised, so the fastest
+	// packet is taken as zero age and everything else is how much staler than that it was.
+	// Call reset() on it to keep a rolling window.
+	tactilus_udp::Histogram& getagehistogram();
+
+	// Starts the counters and the age histogram over
+	void resetstats();
+
 	private:
 
 	char buf[BUFLEN];
+	int buflen = 0; // length of the last message recv() got
+
+	// Updates stats and agehist with the sequence number and timestamp of the len byte packet p
+	void accountpacket(const unsigned char* p, int len);
+
+	// Binds the socket, what every constructor starts with
+	void open(std::string src_serv, u_int src_port, double desired_x_pos, double desired_y_pos);
+
+	// Sleeps on the socket until a sender handshakes
+	void waithandshake();
+
+	// recv() without the check for the receive thread, waiting up to max_wait
+	int take(std::chrono::microseconds max_wait);
+
+	// What the receive thread runs
+	void receiveloop();
+
+	// Waits up to max_wait for a message into buf, keeps where it came from in from
+	int receive(std::chrono::microseconds max_wait);
+
+	// Sets kernelarrival and readtime for the message just read, kernel being its SO_TIMESTAMPNS stamp
+	void stamp(const struct timespec& kernel);
+
+	// Handles handshakes and packets that came before any, true if the message msg from src was only for the session
+	bool control(const char* msg, int len, const struct sockaddr_in& src, socklen_t srclen);
+
+	// The address we shook hands with last, copied under peermutex as the receive thread may be changing it
+	void getpeer(struct sockaddr_in& addr, socklen_t& addrlen);
+
+	// Sends heartbeats, notices the packets stopped
+	void keepalive();
+
+	// Every value of the message in buf, binary or text, up to maxvalues of them
+	int lastvalues(float* values, unsigned int maxvalues);
+
+	// Up to maxvalues numbers in buf, for senders that still send comma separated text
+	int parsetext(float* values, unsigned int maxvalues);
+
+	PacketStats stats = { 0, 0, 0, 0 };
+	bool seqstarted = false;
+	uint32_t lastseq = 0; // highest sequence number seen
+	uint64_t seqwindow = 0; // bit i is set if sequence number lastseq - i has been seen
+	bool offsetstarted = false;
+	int64_t minoffsetus = 0; // smallest receive time minus sender timestamp seen
+	tactilus_udp::Histogram agehist;
+	tactilus_udp::MapDecoder mapdecoder; // every map packet goes through it, so deltas always have their base
+	float maps[MAXSENSORS * MAPPADS];
+	int mapsensors = -1; // what decoding the last packet's maps returned
+	KineticsEngine engine; // runs on the maps for getkinetics()
+	char drainslots[DRAINBATCH][DRAINSLOTLEN]; // what the last recvmmsg() of recvlatest() got
+	struct mmsghdr drainmsgs[DRAINBATCH];
+	struct iovec drainiov[DRAINBATCH];
+	struct sockaddr_in drainfrom[DRAINBATCH];
+	char draincontrol[DRAINBATCH][CMSG_SPACE(sizeof(struct timespec))]; // room for each message's SO_TIMESTAMPNS
+	int older[DRAINBATCH]; // slots of the messages recvlatest() skipped, oldest first
+	unsigned int nolder = 0;
     struct sockaddr_in si_other;
     socklen_t slen;
+	std::mutex peermutex; // guards si_other and slen, a handshake changes them on the receive thread while send() reads them
+    struct sockaddr_in from; // where the last message came from
+    socklen_t fromlen;
+	std::chrono::steady_clock::time_point kernelarrival; // of the last message
+	std::chrono::steady_clock::time_point readtime; // of the last message
+	std::string reply; // what a handshake is answered with, empty for the deprecated constructors that never answered
+	// Atomic as getstate() and gethandshakes() may be called while the receive thread changes them
+	std::atomic<tactilus_udp::SessionState> state{ tactilus_udp::SESSION_HANDSHAKING };
+	std::atomic<unsigned long> handshakes{ 0 };
+	std::thread receiver;
+	std::atomic<bool> receiving{ false }; // whether receiver runs
+	tactilus_udp::TripleBuffer<ReceivedSample> samples; // from receiver to fetchsample()
+	std::chrono::steady_clock::time_point lastpacket; // when the sender was last heard from
+	std::chrono::steady_clock::time_point nextheartbeat;
+	std::chrono::steady_clock::time_point nextrehandshake; // when a sender that streams without a handshake may be asked again
     std::string server_addr;
     udp_client_server::udp_server* svr;
     char addrbuf[32];
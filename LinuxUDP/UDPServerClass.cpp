@@ -25,13 +25,48 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <algorithm>
-#include <sstream>
+#include <time.h>
+#include <poll.h>
 
 #include"TactilusUDP_L.h"
 
 namespace udp_client_server
 {
 
+/** \brief Waits until \p socket has something to read.
+ *
+ * Uses ppoll() on POLLIN alone, so a socket that can be written to doesn't
+ * end the wait, and the timeout can be as short as the kernel's timers allow
+ * instead of whole milliseconds.
+ *
+ * \param[in] socket  The socket to wait on.
+ * \param[in] max_wait  The longest to wait, 0 (or less) just looks.
+ *
+ * \return 1 if there is something to read, 0 if the wait timed out and -1 on error (errno says which, EINTR for a signal).
+ */
+static int wait_readable(int socket, std::chrono::nanoseconds max_wait)
+{
+    if(max_wait < std::chrono::nanoseconds::zero())
+    {
+        max_wait = std::chrono::nanoseconds::zero();
+    }
+    struct pollfd p;
+    p.fd = socket;
+    p.events = POLLIN;
+    p.revents = 0;
+    struct timespec timeout;
+    timeout.tv_sec = (time_t)(max_wait.count() / 1000000000);
+    timeout.tv_nsec = (long)(max_wait.count() % 1000000000);
+    int retval = ppoll(&p, 1, &timeout, NULL);
+    if(retval == -1)
+    {
+        // ppoll() set errno accordingly
+        return -1;
+    }
+    // An error waiting on the socket (POLLERR) counts as readable too, the read then returns it
+    return retval > 0 ? 1 : 0;
+}
+
 
 // ========================= CLIENT =========================
 
@@ -205,27 +240,39 @@ int udp_client::recv(char *msg, size_t max_size)
  */
 int udp_client::timed_recv(char *msg, size_t max_size, int max_wait_ms)
 {
-    fd_set s;
-    FD_ZERO(&s);
-    FD_SET(f_socket, &s);
-    struct timeval timeout;
-    timeout.tv_sec = max_wait_ms / 1000;
-    timeout.tv_usec = (max_wait_ms % 1000) * 1000;
-    int retval = select(f_socket + 1, &s, &s, &s, &timeout);
+    int retval = timed_recv(msg, max_size, std::chrono::milliseconds(max_wait_ms));
+    if(retval == TIMED_OUT)
+    {
+        // our socket has no data
+        errno = EAGAIN;
+        return -1;
+    }
+    return retval;
+}
+
+/** \brief Wait for data to come in with a timeout of any length, down to microseconds.
+ *
+ * Waits on read readiness alone with ppoll(), and tells a timeout apart
+ * from an error by returning TIMED_OUT instead of -1.
+ *
+ * \param[in] msg  The buffer where the message will be saved.
+ * \param[in] max_size  The size of the \p msg buffer in bytes.
+ * \param[in] max_wait  The longest to wait for a message, e.g. std::chrono::microseconds(500).
+ *
+ * \return TIMED_OUT if nothing came in within \p max_wait, -1 if an error occurs, the number of bytes received otherwise.
+ */
+int udp_client::timed_recv(char *msg, size_t max_size, std::chrono::nanoseconds max_wait)
+{
+    int retval = wait_readable(f_socket, max_wait);
     if(retval == -1)
     {
-        // select() set errno accordingly
         return -1;
     }
-    if(retval > 0)
+    if(retval == 0)
     {
-        // our socket has data
-        return ::recv(f_socket, msg, max_size, 0);
+        return TIMED_OUT;
     }
-
-    // our socket has no data
-    errno = EAGAIN;
-    return -1;
+    return ::recv(f_socket, msg, max_size, 0);
 }
 
 // ========================= SERVER =========================
@@ -341,6 +388,20 @@ std::string udp_server::get_addr() const
     return f_addr;
 }
 
+/** \brief Have the kernel stamp every message with the time it arrived.
+ *
+ * Turns on SO_TIMESTAMPNS, timed_recvmsg() and get_timestamp() then give
+ * the CLOCK_REALTIME time the kernel received each message at, however long
+ * it waited in the socket before it was read.
+ *
+ * \return 0, or -1 if the socket doesn't do it (errno says why).
+ */
+int udp_server::enable_timestamps()
+{
+    int on = 1;
+    return setsockopt(f_socket, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+}
+
 /** \brief Wait on a message.
  *
  * This function waits until a message is received on this UDP server.
@@ -385,27 +446,39 @@ int udp_server::recv(char *msg, size_t max_size)
  */
 int udp_server::timed_recv(char *msg, size_t max_size, int max_wait_ms)
 {
-    fd_set s;
-    FD_ZERO(&s);
-    FD_SET(f_socket, &s);
-    struct timeval timeout;
-    timeout.tv_sec = max_wait_ms / 1000;
-    timeout.tv_usec = (max_wait_ms % 1000) * 1000;
-    int retval = select(f_socket + 1, &s, &s, &s, &timeout);
+    int retval = timed_recv(msg, max_size, std::chrono::milliseconds(max_wait_ms));
+    if(retval == TIMED_OUT)
+    {
+        // our socket has no data
+        errno = EAGAIN;
+        return -1;
+    }
+    return retval;
+}
+
+/** \brief Wait for data to come in with a timeout of any length, down to microseconds.
+ *
+ * Waits on read readiness alone with ppoll(), and tells a timeout apart
+ * from an error by returning TIMED_OUT instead of -1.
+ *
+ * \param[in] msg  The buffer where the message will be saved.
+ * \param[in] max_size  The size of the \p msg buffer in bytes.
+ * \param[in] max_wait  The longest to wait for a message, e.g. std::chrono::microseconds(500).
+ *
+ * \return TIMED_OUT if nothing came in within \p max_wait, -1 if an error occurs, the number of bytes received otherwise.
+ */
+int udp_server::timed_recv(char *msg, size_t max_size, std::chrono::nanoseconds max_wait)
+{
+    int retval = wait_readable(f_socket, max_wait);
     if(retval == -1)
     {
-        // select() set errno accordingly
         return -1;
     }
-    if(retval > 0)
+    if(retval == 0)
     {
-        // our socket has data
-        return ::recv(f_socket, msg, max_size, 0);
+        return TIMED_OUT;
     }
-
-    // our socket has no data
-    errno = EAGAIN;
-    return -1;
+    return ::recv(f_socket, msg, max_size, 0);
 }
 
 /** \brief Uses recvfrom() to get source address of sender
@@ -420,6 +493,163 @@ int udp_server::recvfrom(char *msg, size_t max_size, struct sockaddr *addrbuf, s
     return ::recvfrom(f_socket, msg, max_size, 0, addrbuf, addrlen);
 }
 
+/** \brief Waits for a message like timed_recv() and gets its source address like recvfrom()
+ *
+ * Only waits for the socket to become readable, so it sleeps for the whole
+ * \p max_wait_ms unless something arrives.
+ *
+ * \param[in] msg   The buffer where the message is saved
+ * \param[in] max_size  The size of the \p msg buffer in bytes.
+ * \param[in] addrbuf   The buffer where the source address is saved.
+ * \param[in] addrlen   The size of the buffer where the source address is saved.
+ * \param[in] max_wait_ms  The maximum number of milliseconds to wait for a message.
+ *
+ * \return -1 if an error occurs or the function timed out (errno is EAGAIN then), the number of bytes received otherwise.
+ */
+int udp_server::timed_recvfrom(char *msg, size_t max_size, struct sockaddr *addrbuf, socklen_t *addrlen, int max_wait_ms)
+{
+    int retval = timed_recvfrom(msg, max_size, addrbuf, addrlen, std::chrono::milliseconds(max_wait_ms));
+    if(retval == TIMED_OUT)
+    {
+        // our socket has no data
+        errno = EAGAIN;
+        return -1;
+    }
+    return retval;
+}
+
+/** \brief timed_recvfrom() with a timeout of any length, down to microseconds.
+ *
+ * Waits on read readiness alone with ppoll(), and tells a timeout apart
+ * from an error by returning TIMED_OUT instead of -1.
+ *
+ * \param[in] msg  The buffer where the message will be saved.
+ * \param[in] max_size  The size of the \p msg buffer in bytes.
+ * \param[in] addrbuf   The buffer where the source address is saved.
+ * \param[in] addrlen   The size of the buffer where the source address is saved.
+ * \param[in] max_wait  The longest to wait for a message, e.g. std::chrono::microseconds(500).
+ *
+ * \return TIMED_OUT if nothing came in within \p max_wait, -1 if an error occurs, the number of bytes received otherwise.
+ */
+int udp_server::timed_recvfrom(char *msg, size_t max_size, struct sockaddr *addrbuf, socklen_t *addrlen, std::chrono::nanoseconds max_wait)
+{
+    int retval = wait_readable(f_socket, max_wait);
+    if(retval == -1)
+    {
+        return -1;
+    }
+    if(retval == 0)
+    {
+        return TIMED_OUT;
+    }
+    return ::recvfrom(f_socket, msg, max_size, 0, addrbuf, addrlen);
+}
+
+/** \brief Waits for a message like timed_recvfrom() and gets the time the kernel received it at
+ *
+ * Needs enable_timestamps() for the time, \p stamp is 0 without it.
+ *
+ * \param[in] msg   The buffer where the message is saved
+ * \param[in] max_size  The size of the \p msg buffer in bytes.
+ * \param[in] addrbuf   The buffer where the source address is saved.
+ * \param[in] addrlen   The size of the buffer where the source address is saved.
+ * \param[out] stamp   When the kernel received the message, CLOCK_REALTIME.
+ * \param[in] max_wait_ms  The maximum number of milliseconds to wait for a message.
+ *
+ * \return -1 if an error occurs or the function timed out (errno is EAGAIN then), the number of bytes received otherwise.
+ */
+int udp_server::timed_recvmsg(char *msg, size_t max_size, struct sockaddr *addrbuf, socklen_t *addrlen, struct timespec *stamp, int max_wait_ms)
+{
+    int retval = timed_recvmsg(msg, max_size, addrbuf, addrlen, stamp, std::chrono::milliseconds(max_wait_ms));
+    if(retval == TIMED_OUT)
+    {
+        // our socket has no data
+        errno = EAGAIN;
+        return -1;
+    }
+    return retval;
+}
+
+/** \brief timed_recvmsg() with a timeout of any length, down to microseconds.
+ *
+ * Waits on read readiness alone with ppoll(), and tells a timeout apart
+ * from an error by returning TIMED_OUT instead of -1.
+ *
+ * \param[in] msg  The buffer where the message will be saved.
+ * \param[in] max_size  The size of the \p msg buffer in bytes.
+ * \param[in] addrbuf   The buffer where the source address is saved.
+ * \param[in] addrlen   The size of the buffer where the source address is saved.
+ * \param[out] stamp   When the kernel received the message, CLOCK_REALTIME, 0 without enable_timestamps().
+ * \param[in] max_wait  The longest to wait for a message, e.g. std::chrono::microseconds(500).
+ *
+ * \return TIMED_OUT if nothing came in within \p max_wait, -1 if an error occurs, the number of bytes received otherwise.
+ */
+int udp_server::timed_recvmsg(char *msg, size_t max_size, struct sockaddr *addrbuf, socklen_t *addrlen, struct timespec *stamp, std::chrono::nanoseconds max_wait)
+{
+    stamp->tv_sec = 0;
+    stamp->tv_nsec = 0;
+    int retval = wait_readable(f_socket, max_wait);
+    if(retval == -1)
+    {
+        return -1;
+    }
+    if(retval == 0)
+    {
+        return TIMED_OUT;
+    }
+    struct iovec iov;
+    iov.iov_base = msg;
+    iov.iov_len = max_size;
+    char control[CMSG_SPACE(sizeof(struct timespec))];
+    struct msghdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_name = addrbuf;
+    hdr.msg_namelen = *addrlen;
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof(control);
+    int len = ::recvmsg(f_socket, &hdr, 0);
+    if(len >= 0)
+    {
+        *addrlen = hdr.msg_namelen;
+        get_timestamp(&hdr, stamp);
+    }
+    return len;
+}
+
+/** \brief Finds the SO_TIMESTAMPNS time among the control messages of a received message
+ *
+ * \param[in] hdr   The header recvmsg() or recvmmsg() filled in, given room for CMSG_SPACE(sizeof(struct timespec)) of control messages.
+ * \param[out] stamp   When the kernel received the message, CLOCK_REALTIME, or 0 if it wasn't stamped.
+ */
+void udp_server::get_timestamp(const struct msghdr *hdr, struct timespec *stamp)
+{
+    stamp->tv_sec = 0;
+    stamp->tv_nsec = 0;
+    for(struct cmsghdr *c = CMSG_FIRSTHDR(hdr); c != NULL; c = CMSG_NXTHDR(const_cast<struct msghdr *>(hdr), c))
+    {
+        if(c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            memcpy(stamp, CMSG_DATA(c), sizeof(struct timespec));
+        }
+    }
+}
+
+/** \brief Gets the messages waiting on the socket, up to vlen of them, with one recvmmsg() call
+ *
+ * Doesn't wait for anything to arrive, the socket is read with MSG_DONTWAIT.
+ *
+ * \param[in] msgvec  The headers of the buffers the messages are saved in, each one's msg_len is set to its length.
+ * \param[in] vlen  The number of headers in \p msgvec.
+ *
+ * \return -1 if an error occurs or nothing was waiting (errno is EAGAIN then), the number of messages received otherwise.
+ */
+int udp_server::recvmmsg(struct mmsghdr *msgvec, unsigned int vlen)
+{
+    return ::recvmmsg(f_socket, msgvec, vlen, MSG_DONTWAIT, NULL);
+}
+
 
 
 
@@ -438,6 +668,46 @@ namespace tactilus_udp_linux
 {
 	// Added constructor that can tell Windows how many sensors to initialize	
 	TactilusUDP_L::TactilusUDP_L(std::string src_serv, u_int src_port, double desired_x_pos, double desired_y_pos, std::string nsens)
+	{
+		this->open(src_serv, src_port, desired_x_pos, desired_y_pos);
+
+		// Asks for heartbeats too, so the sender notices when this end goes away and waits for it to come back
+		this->reply = std::to_string(desired_x_pos);
+		this->reply.append(",");
+		this->reply.append(std::to_string(desired_y_pos));
+		this->reply.append(",");
+		this->reply.append(nsens);
+		this->reply.append(",heartbeat=");
+		this->reply.append(std::to_string(HEARTBEATMS));
+		this->waithandshake();
+	}
+
+	TactilusUDP_L::TactilusUDP_L(std::string src_serv, u_int src_port, double desired_x_pos, double desired_y_pos, u_int nsens)
+		: TactilusUDP_L(src_serv, src_port, desired_x_pos, desired_y_pos, std::to_string(nsens))
+	{
+	}
+
+	TactilusUDP_L::TactilusUDP_L(std::string src_serv, u_int src_port, double desired_x_pos, double desired_y_pos, u_int nsens, std::string options)
+		: TactilusUDP_L(src_serv, src_port, desired_x_pos, desired_y_pos, options.empty() ? std::to_string(nsens) : std::to_string(nsens) + "," + options)
+	{
+	}
+
+	// DEPRECATED
+	TactilusUDP_L::TactilusUDP_L(std::string src_serv, u_int src_port, double desired_x_pos, double desired_y_pos)
+	{
+		this->open(src_serv, src_port, desired_x_pos, desired_y_pos);
+		this->waithandshake(); // without answering it, as these always did
+	}
+
+	// DEPRECATED
+	TactilusUDP_L::TactilusUDP_L(std::string src_serv, u_int src_port, double desired_x_pos)
+	{
+		this->open(src_serv, src_port, desired_x_pos, 0);
+		this->waithandshake();
+	}
+
+	// Binds src_serv:src_port and makes the socket non-blocking, what every constructor starts with
+	void TactilusUDP_L::open(std::string src_serv, u_int src_port, double desired_x_pos, double desired_y_pos)
 	{
 		this->slen = sizeof(si_other);
 		this->server_addr = src_serv.c_str();
@@ -454,144 +724,443 @@ namespace tactilus_udp_linux
 			// handle the error.  By the way, I've never seen fcntl fail in this way
 		}
 		printf("done\n");
+		// Without it getkernelarrival() is when the message was read
+		if (this->svr->enable_timestamps() == -1)
+		{
+			perror("enabling SO_TIMESTAMPNS");
+		}
+	}
 
+	// Sleeps on the socket until a sender handshakes, asking one that streams already to handshake again
+	void TactilusUDP_L::waithandshake()
+	{
 		printf("Waiting for handshake...\n");
-		memset(this->buf, '\0', BUFLEN);
-		while (svr->recvfrom(this->buf, BUFLEN, (struct sockaddr *) &(this->si_other), &(this->slen)) == -1)
+		while (this->handshakes == 0)
 		{
-			if (errno == EAGAIN)
+			int len = this->receive(std::chrono::milliseconds(HANDSHAKERETRYMS));
+			if (len > 0 && !this->control(this->buf, len, this->from, this->fromlen))
 			{
-				continue;
+				printf("Ignoring a message that isn't a handshake: ");
+				puts(this->buf);
+			}
+			else if (len == -1 && errno != EAGAIN && errno != ECONNREFUSED)
+			{
+				printf("recvfrom() failed with error code : %d\n", errno);
 			}
-			printf("recvfrom() failed with error code : %d", errno);
-			exit(EXIT_FAILURE);
 		}
+	}
 
-		if (strcmp(this->buf, "handshake") != 0)
+	// Waits up to max_wait for a message into buf, 0 terminated, and keeps where it came from in from
+	int TactilusUDP_L::receive(std::chrono::microseconds max_wait)
+	{
+		this->buf[0] = '\0';
+		this->fromlen = sizeof(this->from);
+		struct timespec kernel;
+		int len = this->svr->timed_recvmsg(this->buf, BUFLEN - 1, (struct sockaddr *) &(this->from), &(this->fromlen), &kernel, max_wait);
+		if (len == udp_client_server::TIMED_OUT)
 		{
-			printf("Exiting. Non-handshake received: ");
-			puts(this->buf);
-			exit(EXIT_FAILURE);
+			errno = EAGAIN;
+			return -1;
 		}
-		printf("Handshake received.\n");
-		
-		std::string tosend = std::to_string(desired_x_pos);
-		tosend.append(",");
-		tosend.append(std::to_string(desired_y_pos));
-		tosend.append(",");
-		tosend.append(nsens);
-		this->send(tosend);
+		if (len >= 0)
+		{
+			this->buf[len] = '\0';
+			this->stamp(kernel);
+		}
+		return len;
 	}
 
-	// DEPRECATED
-	TactilusUDP_L::TactilusUDP_L(std::string src_serv, u_int src_port, double desired_x_pos, double desired_y_pos)
+	// Puts the kernel's CLOCK_REALTIME stamp of the message just read on the steady clock, by how long ago it was
+	void TactilusUDP_L::stamp(const struct timespec& kernel)
 	{
-		this->slen = sizeof(si_other);
-		this->server_addr = src_serv.c_str();
-		this->svr = new udp_client_server::udp_server(this->server_addr, src_port);
-		this->x_des = desired_x_pos;
-		this->y_des = desired_y_pos;
-		
-		printf("Setting socket to non-blocking...");
-		// where socketfd is the socket you want to make non-blocking
-		int status = fcntl(this->svr->get_socket(), F_SETFL, fcntl(this->svr->get_socket(), F_GETFL, 0) | O_NONBLOCK);
-		if (status == -1)
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		this->readtime = now;
+		if (kernel.tv_sec == 0 && kernel.tv_nsec == 0)
 		{
-			perror("calling fcntl");
-			// handle the error.  By the way, I've never seen fcntl fail in this way
+			this->kernelarrival = now; // not stamped, as if it had only just arrived
+			return;
 		}
-		printf("done\n");
-		
-		printf("Waiting for handshake...\n");
-		memset(this->buf, '\0', BUFLEN);
-		while (svr->recvfrom(this->buf, BUFLEN, (struct sockaddr *) &(this->si_other), &(this->slen)) == -1)
+		struct timespec real;
+		clock_gettime(CLOCK_REALTIME, &real);
+		int64_t waitedns = ((int64_t)real.tv_sec - kernel.tv_sec) * 1000000000 + (real.tv_nsec - kernel.tv_nsec);
+		this->kernelarrival = now - std::chrono::nanoseconds(waitedns < 0 ? 0 : waitedns); // the realtime clock can step back
+	}
+
+	// Handles the session's side of the len byte message msg from src. Returns true if it was only meant for the session:
+	// a handshake, which is answered with reply, or a packet from a sender that streams without having handshaken with
+	// this object (it restarted), which is asked to handshake again
+	bool TactilusUDP_L::control(const char* msg, int len, const struct sockaddr_in& src, socklen_t srclen)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (tactilus_udp::isControl(msg, len, HANDSHAKEMSG))
+		{
+			if (this->handshakes > 0)
+			{
+				printf("Handshake received again, the sender restarted.\n");
+			}
+			else
+			{
+				printf("Handshake received.\n");
+			}
+			{
+				std::lock_guard<std::mutex> lock(this->peermutex);
+				this->si_other = src;
+				this->slen = srclen;
+			}
+			if (!this->reply.empty())
+			{
+				this->send(this->reply);
+			}
+			// A new Sender counts packets from 0 and starts its maps with a keyframe
+			this->seqstarted = false;
+			this->mapdecoder = tactilus_udp::MapDecoder();
+			this->handshakes++;
+			this->state = tactilus_udp::SESSION_STREAMING;
+			this->lastpacket = now;
+			this->nextheartbeat = now;
+			return true;
+		}
+		if (this->handshakes == 0)
 		{
-                    if (errno == EAGAIN)
-		    {
-                        continue;
-                    }
-			printf("recvfrom() failed with error code : %d", errno);
-			exit(EXIT_FAILURE);
+			if (now >= this->nextrehandshake)
+			{
+				printf("Packets from a sender that hasn't handshaken with us, asking it to handshake again.\n");
+				sendto(this->svr->get_socket(), REHANDSHAKEMSG, strlen(REHANDSHAKEMSG), 0, (const struct sockaddr *) &src, srclen);
+				this->nextrehandshake = now + std::chrono::milliseconds(HANDSHAKERETRYMS);
+			}
+			return tactilus_udp::isPacket((const unsigned char*)msg, len);
 		}
-		
-		if (strcmp(this->buf, "handshake")!=0)
+		this->lastpacket = now;
+		if (this->state != tactilus_udp::SESSION_STREAMING)
 		{
-			printf("Exiting. Non-handshake received: ");
-			puts(this->buf);
-			exit(EXIT_FAILURE);
+			printf("Packets are arriving again.\n");
+			this->state = tactilus_udp::SESSION_STREAMING;
 		}
-		printf("Handshake received.\n");
+		return false;
 	}
 
-	// DEPRECATED
-	TactilusUDP_L::TactilusUDP_L(std::string src_serv, u_int src_port, double desired_x_pos)
+	// Heartbeats to the sender while packets arrive, and noticing when they stop
+	void TactilusUDP_L::keepalive()
 	{
-		this->slen = sizeof(si_other);
-		this->server_addr = src_serv.c_str();
-		this->svr = new udp_client_server::udp_server(this->server_addr, src_port);
-		this->x_des = desired_x_pos;
-		
-		printf("Setting socket to non-blocking...");
-		// where socketfd is the socket you want to make non-blocking
-		int status = fcntl(this->svr->get_socket(), F_SETFL, fcntl(this->svr->get_socket(), F_GETFL, 0) | O_NONBLOCK);
-		if (status == -1)
+		if (this->state != tactilus_udp::SESSION_STREAMING)
 		{
-			perror("calling fcntl");
-			// handle the error.  By the way, I've never seen fcntl fail in this way
+			return;
 		}
-		printf("done\n");
-		
-		printf("Waiting for handshake...\n");
-		memset(this->buf, '\0', BUFLEN);
-		while (svr->recvfrom(this->buf, BUFLEN, (struct sockaddr *) &(this->si_other), &(this->slen)) == -1)
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now - this->lastpacket > std::chrono::milliseconds(STREAMTIMEOUTMS))
 		{
-                    if (errno == EAGAIN)
-		    {
-                        continue;
-                    }
-			printf("recvfrom() failed with error code : %d", errno);
-			exit(EXIT_FAILURE);
+			printf("No packets for %d ms, waiting for the sender to handshake again.\n", STREAMTIMEOUTMS);
+			this->state = tactilus_udp::SESSION_HANDSHAKING;
+			return;
 		}
-		
-		if (strcmp(this->buf, "handshake")!=0)
+		if (now >= this->nextheartbeat && !this->reply.empty())
 		{
-			printf("Exiting. Non-handshake received: ");
-			puts(this->buf);
-			exit(EXIT_FAILURE);
+			// Failing is fine, the sender then stops hearing them and handshakes again once it can
+			struct sockaddr_in peer;
+			socklen_t peerlen;
+			this->getpeer(peer, peerlen);
+			sendto(this->svr->get_socket(), HEARTBEATMSG, strlen(HEARTBEATMSG), 0, (struct sockaddr *) &peer, peerlen);
+			this->nextheartbeat = now + std::chrono::milliseconds(HEARTBEATMS);
 		}
-		printf("Handshake received.\n");
 	}
-	
+
 	TactilusUDP_L::~TactilusUDP_L()
 	{
+		this->stopreceiving();
 		this->svr->~udp_server();
 	}
+	// Where send() and the heartbeats go, as of the last handshake
+	void TactilusUDP_L::getpeer(struct sockaddr_in& addr, socklen_t& addrlen)
+	{
+		std::lock_guard<std::mutex> lock(this->peermutex);
+		addr = this->si_other;
+		addrlen = this->slen;
+	}
+
 	// Send something to the address we shook hands with
 	void TactilusUDP_L::send(std::string msg)
 	{
-		memset(this->buf, '\0', BUFLEN);
-		if (sendto(this->svr->get_socket(), msg.c_str(), strlen(msg.c_str()), 0, (struct sockaddr *) &(this->si_other), this->slen) == -1)
+		struct sockaddr_in peer;
+		socklen_t peerlen;
+		this->getpeer(peer, peerlen);
+		if (sendto(this->svr->get_socket(), msg.c_str(), strlen(msg.c_str()), 0, (struct sockaddr *) &peer, peerlen) == -1)
         {
-            printf("send() failed with error code : %d", errno);
-            exit(EXIT_FAILURE);
+            printf("send() failed with error code : %d\n", errno);
         }
 	}
 	// Writes to buf internal variable what we receive, repeats many times if necessary
 	int TactilusUDP_L::recv()
 	{
-		memset(this->buf, '\0', BUFLEN);
-		int lengthofmsg = this->svr->timed_recv(this->buf, BUFLEN, 1);
+		if (this->receiving.load(std::memory_order_relaxed))
+		{
+			errno = EBUSY; // the receive thread owns the socket and buf
+			return -1;
+		}
+		return this->take(std::chrono::milliseconds(1));
+	}
+
+	// Same, waiting as long as the caller can afford
+	int TactilusUDP_L::recv(std::chrono::microseconds max_wait)
+	{
+		if (this->receiving.load(std::memory_order_relaxed))
+		{
+			errno = EBUSY;
+			return -1;
+		}
+		return this->take(max_wait);
+	}
+
+	// What recv() does, waiting up to max_wait
+	int TactilusUDP_L::take(std::chrono::microseconds max_wait)
+	{
+		int lengthofmsg = this->receive(max_wait);
+		int error = errno;
+		this->buflen = lengthofmsg < 0 ? 0 : lengthofmsg;
+		this->mapsensors = -1;
+		this->nolder = 0;
+		if (lengthofmsg > 0 && this->control(this->buf, lengthofmsg, this->from, this->fromlen))
+		{
+			// Only meant for the session, nothing for the caller
+			this->buflen = 0;
+			this->buf[0] = '\0';
+			lengthofmsg = -1;
+			error = EAGAIN;
+		}
+		else if (tactilus_udp::isPacket((const unsigned char*)this->buf, this->buflen))
+		{
+			this->accountpacket((const unsigned char*)this->buf, this->buflen);
+			this->mapsensors = this->mapdecoder.decode((const unsigned char*)this->buf, this->buflen, this->maps, MAXSENSORS);
+		}
+		this->keepalive();
         if (lengthofmsg == -1)
         {
-            if (errno == EAGAIN)
+            // ECONNREFUSED is the ICMP port unreachable a heartbeat got back from a sender that isn't there (yet)
+            if (error != EAGAIN && error != ECONNREFUSED)
             {
-                //printf("recv() timed out\n");
-                return -1;
+                printf("recv() failed with error code : %d\n", error);
             }
-            printf("recv() failed with error code : %d\n", errno);
-            exit(EXIT_FAILURE);
+            errno = EAGAIN;
+            return -1;
         } else {return lengthofmsg;}
 	}
+
+	// Empties the socket with recvmmsg(), DRAINBATCH messages a call, and keeps the newest message for the caller in buf.
+	// Every message still goes through the session, and every packet through the counters and the map decoder, whose
+	// deltas need each packet in turn. Nothing else of the older ones is decoded unless getolder() asks for it
+	int TactilusUDP_L::recvlatest(unsigned int* skipped)
+	{
+		if (this->receiving.load(std::memory_order_relaxed))
+		{
+			errno = EBUSY;
+			return -1;
+		}
+		this->buflen = 0;
+		this->buf[0] = '\0';
+		this->mapsensors = -1;
+		this->nolder = 0;
+		unsigned int messages = 0; // for the caller, over every batch
+		int error = EAGAIN;
+		int got;
+		do
+		{
+			for (unsigned int i = 0; i < DRAINBATCH; ++i)
+			{
+				this->drainiov[i].iov_base = this->drainslots[i];
+				this->drainiov[i].iov_len = DRAINSLOTLEN;
+				memset(&this->drainmsgs[i].msg_hdr, 0, sizeof(this->drainmsgs[i].msg_hdr)); // msg_len stays, getolder() needs it
+				this->drainmsgs[i].msg_hdr.msg_name = &(this->drainfrom[i]);
+				this->drainmsgs[i].msg_hdr.msg_namelen = sizeof(this->drainfrom[i]);
+				this->drainmsgs[i].msg_hdr.msg_iov = &(this->drainiov[i]);
+				this->drainmsgs[i].msg_hdr.msg_iovlen = 1;
+				this->drainmsgs[i].msg_hdr.msg_control = this->draincontrol[i];
+				this->drainmsgs[i].msg_hdr.msg_controllen = sizeof(this->draincontrol[i]);
+			}
+			got = this->svr->recvmmsg(this->drainmsgs, DRAINBATCH);
+			error = errno;
+			int newest = -1;
+			int newestmaps = -1;
+			for (int i = 0; i < got; ++i)
+			{
+				const char* msg = this->drainslots[i];
+				int len = (int)this->drainmsgs[i].msg_len;
+				// A message too long for a slot is cut short, and no use to anyone
+				if (len == 0 || (this->drainmsgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+					|| this->control(msg, len, this->drainfrom[i], this->drainmsgs[i].msg_hdr.msg_namelen))
+				{
+					continue;
+				}
+				newestmaps = -1;
+				if (tactilus_udp::isPacket((const unsigned char*)msg, len))
+				{
+					this->accountpacket((const unsigned char*)msg, len);
+					newestmaps = this->mapdecoder.decode((const unsigned char*)msg, len, this->maps, MAXSENSORS);
+				}
+				if (newest >= 0)
+				{
+					this->older[this->nolder] = newest;
+					this->nolder++;
+				}
+				else
+				{
+					this->nolder = 0; // a newer message for the caller, the older ones of an earlier batch are overwritten by now
+				}
+				newest = i;
+				messages++;
+			}
+			if (newest >= 0)
+			{
+				this->buflen = (int)this->drainmsgs[newest].msg_len;
+				memcpy(this->buf, this->drainslots[newest], this->buflen);
+				this->buf[this->buflen] = '\0';
+				this->mapsensors = newestmaps;
+				struct timespec kernel;
+				udp_client_server::udp_server::get_timestamp(&(this->drainmsgs[newest].msg_hdr), &kernel);
+				this->stamp(kernel);
+			}
+			else if (got > 0)
+			{
+				// Only control messages, the skipped ones in slots they didn't land in are still there
+				unsigned int kept = 0;
+				for (unsigned int j = 0; j < this->nolder; ++j)
+				{
+					if (this->older[j] >= got)
+					{
+						this->older[kept++] = this->older[j];
+					}
+				}
+				this->nolder = kept;
+			}
+		} while (got == DRAINBATCH);
+		this->keepalive();
+		if (skipped != NULL)
+		{
+			*skipped = messages > 0 ? messages - 1 : 0;
+		}
+		if (messages == 0)
+		{
+			if (got == -1 && error != EAGAIN && error != ECONNREFUSED)
+			{
+				printf("recvmmsg() failed with error code : %d\n", error);
+			}
+			errno = EAGAIN;
+			return -1;
+		}
+		return this->buflen;
+	}
+
+	// Decodes one of the messages recvlatest() skipped, they stay in their slots until it's called again
+	int TactilusUDP_L::getolder(unsigned int age, tactilus_udp::PacketHeader& hdr, float* values, unsigned int maxvalues)
+	{
+		if (age < 1 || age > this->nolder)
+		{
+			return -1;
+		}
+		int slot = this->older[this->nolder - age];
+		return tactilus_udp::decodePacket((const unsigned char*)this->drainslots[slot], this->drainmsgs[slot].msg_len, hdr, values, maxvalues);
+	}
+
+	// Newest values, binary or text, after emptying the socket
+	int TactilusUDP_L::getlatest(float* values, unsigned int maxvalues, unsigned int* skipped)
+	{
+		if (this->recvlatest(skipped) == -1) {
+			return -1;
+		}
+		return this->lastvalues(values, maxvalues);
+	}
+
+	// Starts the thread that receives from here on, false if it runs already
+	bool TactilusUDP_L::startreceiving()
+	{
+		if (this->receiving.load())
+		{
+			return false;
+		}
+		this->receiving.store(true);
+		this->receiver = std::thread(&TactilusUDP_L::receiveloop, this);
+		return true;
+	}
+
+	// Stops the receive thread, and waits for it to finish
+	void TactilusUDP_L::stopreceiving()
+	{
+		if (!this->receiving.load())
+		{
+			return;
+		}
+		this->receiving.store(false);
+		this->receiver.join();
+	}
+
+	// The receive thread: sleeps on the socket, and turns each message for the caller into a sample
+	void TactilusUDP_L::receiveloop()
+	{
+		unsigned long received = 0;
+		while (this->receiving.load(std::memory_order_relaxed))
+		{
+			if (this->take(std::chrono::milliseconds(RECEIVETHREADWAITMS)) == -1)
+			{
+				continue;
+			}
+			ReceivedSample& sample = this->samples.writebuffer();
+			sample.nvalues = this->getpacket(sample.hdr, sample.values, MAXTEXTVALUES);
+			sample.binary = sample.nvalues >= 0;
+			if (sample.binary)
+			{
+				sample.nvalues = std::min(sample.nvalues, MAXTEXTVALUES);
+			}
+			else
+			{
+				memset(&sample.hdr, 0, sizeof(sample.hdr));
+				sample.nvalues = this->parsetext(sample.values, MAXTEXTVALUES);
+			}
+			sample.mapsensors = this->mapsensors;
+			if (this->mapsensors > 0)
+			{
+				memcpy(sample.maps, this->maps, std::min(this->mapsensors, MAXSENSORS) * MAPPADS * sizeof(float));
+			}
+			received++;
+			sample.received = received;
+			sample.arrival = this->readtime;
+			sample.kernelarrival = this->kernelarrival;
+			sample.stats = this->stats;
+			this->samples.publish();
+		}
+	}
+
+	// Latest sample from the receive thread, without a system call
+	bool TactilusUDP_L::fetchsample()
+	{
+		return this->samples.fetch();
+	}
+
+	const ReceivedSample& TactilusUDP_L::getsample() const
+	{
+		return this->samples.readbuffer();
+	}
+
+	// When the kernel got the last message
+	std::chrono::steady_clock::time_point TactilusUDP_L::getkernelarrival()
+	{
+		return this->kernelarrival;
+	}
+
+	// When the last message was read from the socket
+	std::chrono::steady_clock::time_point TactilusUDP_L::getreadtime()
+	{
+		return this->readtime;
+	}
+
+	// Where the session with the sender is
+	tactilus_udp::SessionState TactilusUDP_L::getstate()
+	{
+		return this->state;
+	}
+
+	// How many times a sender has handshaken with this object
+	unsigned long TactilusUDP_L::gethandshakes()
+	{
+		return this->handshakes;
+	}
 	
 	// Returns buffer that we received on
 	char* TactilusUDP_L::getbuf()
@@ -602,135 +1171,84 @@ namespace tactilus_udp_linux
 	// Get force in N
 	std::vector<float> TactilusUDP_L::getforce()
 	{
-		std::string s = "*: force";
-		this->send(s);
-		this->recv();
-		char* forcech = this->getbuf();
-		std::string forces(forcech);
-		std::replace(forces.begin(), forces.end(), ',', ' ');
-		// The following is just to convert string to vector
-		std::vector<float> array;
-		std::stringstream ss(forces);
-		float temp;
-		while (ss >> temp)
-			array.push_back(temp);
-		return array;
-
+		return this->getfields(tactilus_udp::FIELD_FORCE, "*");
 	}
 	
 	// Get moment in Nm
 	std::vector<float> TactilusUDP_L::getmoment()
 	{
-		std::string s = "*: moment";
-		s.append(std::to_string(this->x_des));
-		this->send(s);
-		this->recv();
-		char* momentch = this->getbuf();
-		std::string moments(momentch);
-		std::replace(moments.begin(), moments.end(), ',', ' ');
-		// The following is just to convert string to vector
-		std::vector<float> array;
-		std::stringstream ss(moments);
-		float temp;
-		while (ss >> temp)
-			array.push_back(temp);
-		return array;
+		return this->getfields(tactilus_udp::FIELD_MOMENTY, "*");
 	}
 	// Get force in N and moment in Nm at the same time
 	std::vector<float> TactilusUDP_L::getforcemoment()
 	{
-		std::string s = "*: force, moment";
-		s.append(std::to_string(this->x_des));
-		this->send(s);
-		this->recv();
-		char* forcemomentch = this->getbuf();
-		std::string forcemoments(forcemomentch);
-		std::replace(forcemoments.begin(), forcemoments.end(), ',', ' ');
-		// The following is just to convert string to vector
-		std::vector<float> array;
-		std::stringstream ss(forcemoments);
-		float temp;
-		while (ss >> temp)
-			array.push_back(temp);
-		return array;
+		return this->getfields(tactilus_udp::FIELD_FORCE | tactilus_udp::FIELD_MOMENTY, "*");
 	}
 	// Get force in N and moment in Nm at the same time
 	std::vector<float> TactilusUDP_L::getforcemoments()
 	{
-		std::string s = "*: force, moments";
-		s.append(std::to_string(this->x_des));
-		s.append(",");
-		s.append(std::to_string(this->y_des));
-		this->send(s);
-		this->recv();
-		char* forcemomentch = this->getbuf();
-		std::string forcemoments(forcemomentch);
-		std::replace(forcemoments.begin(), forcemoments.end(), ',', ' ');
-		// The following is just to convert string to vector
-		std::vector<float> array;
-		std::stringstream ss(forcemoments);
-		float temp;
-		while (ss >> temp)
-			array.push_back(temp);
-		return array;
+		return this->getfields(tactilus_udp::FIELD_FORCE | tactilus_udp::FIELD_MOMENTY | tactilus_udp::FIELD_MOMENTX, "*");
 	}
 
 	// Get force in N, sensornum is either 1, 2, or *
 	std::vector<float> TactilusUDP_L::getforce(std::string sensornum)
 	{
-		std::string s = sensornum;
-		s.append(": force");
-		this->send(s);
-		this->recv();
-		char* forcech = this->getbuf();
-		std::string forces(forcech);
-		std::replace(forces.begin(), forces.end(), ',', ' ');
-		// The following is just to convert string to vector
-		std::vector<float> array;
-		std::stringstream ss(forces);
-		float temp;
-		while (ss >> temp)
-			array.push_back(temp);
-		return array;
-
+		return this->getfields(tactilus_udp::FIELD_FORCE, sensornum);
 	}
 	// Get moment in Nm, sensornum is either 1, 2, or *
 	std::vector<float> TactilusUDP_L::getmoment(std::string sensornum)
 	{
-		std::string s = sensornum;
-		s.append(": moment");
-		s.append(std::to_string(this->x_des));
-		this->send(s);
-		this->recv();
-		char* momentch = this->getbuf();
-		std::string moments(momentch);
-		std::replace(moments.begin(), moments.end(), ',', ' ');
-		// The following is just to convert string to vector
-		std::vector<float> array;
-		std::stringstream ss(moments);
-		float temp;
-		while (ss >> temp)
-			array.push_back(temp);
-		return array;
+		return this->getfields(tactilus_udp::FIELD_MOMENTY, sensornum);
 	}
 	// Get force in N and moment in Nm at the same time, sensornum is either 1, 2, or *
 	std::vector<float> TactilusUDP_L::getforcemoment(std::string sensornum)
 	{
-		std::string s = sensornum;
-		s.append(": force, moment");
-		s.append(std::to_string(this->x_des));
-		this->send(s);
-		this->recv();
-		char* forcemomentch = this->getbuf();
-		std::string forcemoments(forcemomentch);
-		std::replace(forcemoments.begin(), forcemoments.end(), ',', ' ');
-		// The following is just to convert string to vector
-		std::vector<float> array;
-		std::stringstream ss(forcemoments);
-		float temp;
-		while (ss >> temp)
-			array.push_back(temp);
-		return array;
+		return this->getfields(tactilus_udp::FIELD_FORCE | tactilus_udp::FIELD_MOMENTY, sensornum);
+	}
+	// Values of the requested fields, sensor by sensor, from the next packet. The sender decides what it sends
+	// at the handshake, so nothing is asked for here, fields it doesn't send are left out
+	std::vector<float> TactilusUDP_L::getfields(uint32_t fields, std::string sensornum)
+	{
+		float values[MAXTEXTVALUES];
+		unsigned int wanted = sensornum == "*" ? 0 : (unsigned int)strtoul(sensornum.c_str(), NULL, 10);
+		int nvalues = this->getfields(fields, wanted, values, MAXTEXTVALUES);
+		if (nvalues < 0) {
+			std::vector<float> array(1,-1.0);
+			return array;
+		}
+		return std::vector<float>(values, values + nvalues);
+	}
+	// Same into the caller's array, sensor 0 for every sensor
+	int TactilusUDP_L::getfields(uint32_t fields, unsigned int sensor, float* values, unsigned int maxvalues)
+	{
+		if(this->recv()==-1) {
+			return -1;
+		}
+		tactilus_udp::PacketHeader hdr;
+		float all[MAXSENSORS * MAXFIELDS];
+		int nvalues = this->getpacket(hdr, all, MAXSENSORS * MAXFIELDS);
+		if (nvalues < 0)
+		{
+			return this->parsetext(values, maxvalues); // comma separated text, which has no field mask to pick from
+		}
+		unsigned int persensor = tactilus_udp::packetFieldCount(hdr.fields);
+		unsigned int n = 0;
+		for (unsigned int s = 0; s < hdr.sensors; ++s)
+		{
+			if (sensor != 0 && sensor != s + 1) {
+				continue;
+			}
+			for (uint32_t rest = fields; rest != 0 && n < maxvalues; rest &= rest - 1)
+			{
+				int offset = tactilus_udp::fieldOffset(hdr.fields, rest & (~rest + 1)); // lowest bit left
+				unsigned int at = s * persensor + offset;
+				if (offset >= 0 && at < (unsigned int)nvalues && at < MAXSENSORS * MAXFIELDS) {
+					values[n] = all[at];
+					++n;
+				}
+			}
+		}
+		return (int)n;
 	}
 	// Get force in N and moment in Nm at the same time, sensornum is either 1, 2, or *
 	std::vector<float> TactilusUDP_L::getforcemoments(std::string sensornum)
@@ -741,25 +1259,153 @@ namespace tactilus_udp_linux
 		s.append(",");
 		s.append(std::to_string(this->y_des));*/
 		//this->send(s);
-		if(this->recv()==-1) {
+		float values[MAXTEXTVALUES];
+		int nvalues = this->getvalues(values, MAXTEXTVALUES);
+		if (nvalues < 0) {
 			std::vector<float> array(1,-1.0);
 			return array;
 		}
-		char* forcemomentch = this->getbuf();
-		std::string forcemoments(forcemomentch);
-		std::replace(forcemoments.begin(), forcemoments.end(), ',', ' ');
-		// The following is just to convert string to vector
-		std::vector<float> array;
-		std::stringstream ss(forcemoments);
-		float temp;
-		while (ss >> temp)
-			array.push_back(temp);
-		return array;
+		return std::vector<float>(values, values + nvalues);
+	}
+	// Every value of the next message into the caller's array
+	int TactilusUDP_L::getvalues(float* values, unsigned int maxvalues)
+	{
+		if(this->recv()==-1) {
+			return -1;
+		}
+		return this->lastvalues(values, maxvalues);
+	}
+	// Every value of the message in buf
+	int TactilusUDP_L::lastvalues(float* values, unsigned int maxvalues)
+	{
+		tactilus_udp::PacketHeader hdr;
+		int nvalues = this->getpacket(hdr, values, maxvalues);
+		if (nvalues >= 0)
+		{
+			return std::min(nvalues, (int)maxvalues);
+		}
+		// Not a binary packet, so it's from a sender that still sends comma separated text
+		return this->parsetext(values, maxvalues);
 	}
 
+	// Numbers in buf, for senders that still send comma separated text
+	int TactilusUDP_L::parsetext(float* values, unsigned int maxvalues)
+	{
+		return (int)tactilus_udp::scanFloats(this->buf, this->buflen, values, maxvalues);
+	}
 
+	// Decodes the last binary packet recv() got, no string work involved
+	int TactilusUDP_L::getpacket(tactilus_udp::PacketHeader& hdr, float* values, unsigned int maxvalues)
+	{
+		return tactilus_udp::decodePacket((const unsigned char*)this->buf, this->buflen, hdr, values, maxvalues);
+	}
 
-}
+	// Maps of the last packet, decoded in recv()
+	int TactilusUDP_L::getmap(float* kPa, unsigned int maxsensors)
+	{
+		if (this->receiving.load(std::memory_order_relaxed))
+		{
+			errno = EBUSY;
+			return -1;
+		}
+		if (this->mapsensors > 0)
+		{
+			unsigned int n = (unsigned int)this->mapsensors < maxsensors ? (unsigned int)this->mapsensors : maxsensors;
+			memcpy(kPa, this->maps, n * MAPPADS * sizeof(float));
+		}
+		return this->mapsensors;
+	}
+
+	// Kinetics of the last packet's maps, worked out here
+	int TactilusUDP_L::getkinetics(tactilus_udp_linux::FrameKinetics* k, unsigned int maxsensors)
+	{
+		if (this->receiving.load(std::memory_order_relaxed))
+		{
+			errno = EBUSY;
+			return -1;
+		}
+		for (int i = 0; i < this->mapsensors && (unsigned int)i < maxsensors; ++i)
+		{
+			this->engine.compute(this->maps + i * MAPPADS, k[i]);
+		}
+		return this->mapsensors;
+	}
 
+	// Received, lost, reordered and duplicate packet counts
+	PacketStats TactilusUDP_L::getstats()
+	{
+		return this->stats;
+	}
+
+	// Age of each received sample relative to the freshest one, in microseconds
+	tactilus_udp::Histogram& TactilusUDP_L::getagehistogram()
+	{
+		return this->agehist;
+	}
 
-   
+	// Starts the counters and the age histogram over
+	void TactilusUDP_L::resetstats()
+	{
+		memset(&this->stats, 0, sizeof(this->stats));
+		this->seqstarted = false;
+		this->offsetstarted = false;
+		this->agehist.reset();
+	}
+
+	// Updates stats and agehist with the sequence number and timestamp of the packet in buf
+	void TactilusUDP_L::accountpacket(const unsigned char* p, int len)
+	{
+		if (len < PACKETHEADERLEN || p[2] < 2)
+		{
+			this->stats.received++; // version 1 packets carry no sequence number or timestamp
+			return;
+		}
+		uint32_t seq = tactilus_udp::getu32(p + 8);
+		uint64_t timestampus = tactilus_udp::getu64(p + 12);
+		this->stats.received++;
+
+		int32_t diff = (int32_t)(seq - this->lastseq);
+		if (!this->seqstarted || diff < -1000)
+		{
+			// First packet, or the sender restarted and began counting from 0 again
+			this->seqstarted = true;
+			this->lastseq = seq;
+			this->seqwindow = 1;
+		}
+		else if (diff > 0)
+		{
+			this->stats.lost += diff - 1;
+			this->seqwindow = diff >= 64 ? 0 : this->seqwindow << diff;
+			this->seqwindow |= 1;
+			this->lastseq = seq;
+		}
+		else if (diff == 0 || (-diff < 64 && (this->seqwindow & ((uint64_t)1 << -diff))))
+		{
+			this->stats.duplicate++;
+		}
+		else
+		{
+			// Older than the newest packet and not seen before, so it was counted lost when the newer one came in
+			if (-diff < 64)
+			{
+				this->seqwindow |= (uint64_t)1 << -diff;
+			}
+			this->stats.reordered++;
+			if (this->stats.lost > 0)
+			{
+				this->stats.lost--;
+			}
+		}
+
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		uint64_t recvus = (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+		int64_t offsetus = (int64_t)(recvus - timestampus);
+		if (!this->offsetstarted || offsetus < this->minoffsetus)
+		{
+			this->offsetstarted = true;
+			this->minoffsetus = offsetus;
+		}
+		this->agehist.record((uint64_t)(offsetus - this->minoffsetus));
+	}
+}
@@ -15,6 +15,7 @@
 #define SERVER "10.7.0.11"   //IP address of UDP Server received on
 #define PORT 29292             //The port on which to listen for incoming data
 #define NUMBERPADS 2
+#define NUMSENSORS 2            //How many insoles the sender should open, 1 to MAXSENSORS
 
 // Runs during signal interrupt ctrl-c
 /*void signal_callback_handler(int signum) {
@@ -27,8 +28,9 @@ int main()
 {
     struct timespec start_r, stop_r, curr_time; // initialize structures
     float realtime;
-    tactilus_udp_linux::TactilusUDP_L tact = 
-        tactilus_udp_linux::TactilusUDP_L(SERVER, PORT, 10, 5, "2"); // 10mm is how far from the back of the foot the y moment will be calculated, 5mm is how far from the inside of the insole the x moment will be calculated, 1 (or 2) is how many sensors are used
+    tactilus_udp_linux::TactilusUDP_L tact(SERVER, PORT, 10, 5, NUMSENSORS); // 10mm is how far from the back of the foot the y moment will be calculated, 5mm is how far from the inside of the insole the x moment will be calculated, NUMSENSORS is how many sensors are used
+	// neon on the BeagleBone only when built with -mfpu=neon, otherwise the maps are swept with scalar code
+	printf("Kinetics on the maps sweep with %s\n", tactilus_udp_linux::KineticsEngine().backend());
     char msg[BUFLEN];
     std::string msgstring;
 	
@@ -36,13 +38,15 @@ int main()
     float padforce1[NUMBERPADS];
     float force2, momentx2, momenty2;
     float padforce2[NUMBERPADS];
-    std::vector<float> forcemoments;
-	std::vector<float> forcemomentstemp;
+    const float* forcemoments;
+	unsigned long lastreceived = 0;
 	
     // Register signal and signal hadnler
     //signal(SIGINT, signal_callback_handler);
     // start communication	
 	unsigned long recv_counter = 0;
+	// A thread of its own receives and decodes, this loop only picks up the newest sample without touching the socket
+	tact.startreceiving();
     while (1)
     {
 	// The below commented code can be used to send any request that has been implemented on Windows, e.g.
@@ -78,8 +82,7 @@ int main()
 	    std::cout << "clock realtime error!" << std::endl;
 	}*/
 	recv_counter++;	
-	forcemomentstemp = tact.getforcemoments("1");
-	if (forcemomentstemp[0] < 0.0) {
+	if (!tact.fetchsample() || tact.getsample().nvalues < 1) {
 		/*if(clock_gettime(CLOCK_REALTIME,&stop_r) == -1) {
 	    std::cout << "clock realtime error!" << std::endl;
 		}
@@ -91,10 +94,10 @@ int main()
 		std::cout << recv_counter << " Time: " << realtime << std::endl;
 		continue;
 	} else {
-		while(forcemomentstemp[0] >= 0.0) {
-			forcemoments = forcemomentstemp;
-			forcemomentstemp = tact.getforcemoments("1");
-		}
+		const tactilus_udp_linux::ReceivedSample& sample = tact.getsample();
+		forcemoments = sample.values;
+		printf("Skipped %lu older packets\n", sample.received - lastreceived - 1);
+		lastreceived = sample.received;
 		/*if(clock_gettime(CLOCK_REALTIME,&stop_r) == -1) {
 	    std::cout << "clock realtime error!" << std::endl;
 		}
@@ -135,6 +138,15 @@ int main()
 		printf(" %f N", padforce2[i]);
 	}
 	printf("\n");
+	if (recv_counter % 1000 == 0) {
+		// Packet accounting and how stale the samples were over the last 1000 loops
+		const tactilus_udp_linux::PacketStats& stats = tact.getsample().stats; // getstats() is the receive thread's while it runs
+		tactilus_udp::Histogram& age = tact.getagehistogram();
+		printf("Packets received %lu lost %lu reordered %lu duplicate %lu\n", stats.received, stats.lost, stats.reordered, stats.duplicate);
+		printf("Session %s, %lu handshakes\n", tactilus_udp::sessionStateName(tact.getstate()), tact.gethandshakes());
+		printf("Sample age p50 %llu us p99 %llu us max %llu us\n", (unsigned long long)age.percentile(50), (unsigned long long)age.percentile(99), (unsigned long long)age.max());
+		age.reset();
+	}
         //printf("Requesting at ~200Hz\n");
         //sleep(0.005); // I don't think this sleep is necessary? Requesting by itself takes about 3-4 ms per loop
 	/*	
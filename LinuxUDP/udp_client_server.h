@@ -20,11 +20,16 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
+#include <time.h>
 #include <stdexcept>
+#include <chrono>
 
 namespace udp_client_server
 {
 
+// What the timed receives that take a std::chrono duration return when nothing came in, the others return -1 with errno EAGAIN
+const int TIMED_OUT = -2;
+
 class udp_client_server_runtime_error : public std::runtime_error
 {
 public:
@@ -45,6 +50,7 @@ public:
     int                 send(const char *msg, size_t size);
     int                 recv(char *msg, size_t max_size);
     int                 timed_recv(char *msg, size_t max_size, int max_wait_ms);
+    int                 timed_recv(char *msg, size_t max_size, std::chrono::nanoseconds max_wait);
 
 private:
     int                 f_socket;
@@ -63,10 +69,19 @@ public:
     int                 get_socket() const;
     int                 get_port() const;
     std::string         get_addr() const;
+    int                 enable_timestamps();
 
     int                 recv(char *msg, size_t max_size);
     int                 timed_recv(char *msg, size_t max_size, int max_wait_ms);
+    int                 timed_recv(char *msg, size_t max_size, std::chrono::nanoseconds max_wait);
     int                 recvfrom(char *msg, size_t max_size, struct sockaddr *addrbuf, socklen_t *addrlen);
+    int                 timed_recvfrom(char *msg, size_t max_size, struct sockaddr *addrbuf, socklen_t *addrlen, int max_wait_ms);
+    int                 timed_recvfrom(char *msg, size_t max_size, struct sockaddr *addrbuf, socklen_t *addrlen, std::chrono::nanoseconds max_wait);
+    int                 timed_recvmsg(char *msg, size_t max_size, struct sockaddr *addrbuf, socklen_t *addrlen, struct timespec *stamp, int max_wait_ms);
+    int                 timed_recvmsg(char *msg, size_t max_size, struct sockaddr *addrbuf, socklen_t *addrlen, struct timespec *stamp, std::chrono::nanoseconds max_wait);
+    int                 recvmmsg(struct mmsghdr *msgvec, unsigned int vlen);
+
+    static void         get_timestamp(const struct msghdr *hdr, struct timespec *stamp);
 
 private:
     int                 f_socket;
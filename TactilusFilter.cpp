@@ -0,0 +1,385 @@
+#include "TactilusFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#define PI 3.14159265358979
+#define FILTERBLOCK 16 // pads the FIR and Savitzky-Golay filters sum at once, NUMPADS must be a multiple
+
+namespace tactilus_udp
+{
+	namespace
+	{
+		unsigned int clamplength(unsigned int length)
+		{
+			return length < 1 ? 1 : (length > MAXFILTERLEN ? MAXFILTERLEN : length);
+		}
+
+		class PassThrough : public TemporalFilter
+		{
+		public:
+			void filter(const float* kPa, float* out)
+			{
+				if (out != kPa) {
+					memcpy(out, kPa, NUMPADS * sizeof(float));
+				}
+			}
+			void reset() {}
+			const char* name() { return "none"; }
+		};
+
+		// Running sum per pad, so the average costs 2*128 adds per frame instead of length*128.
+		// Once per lap of the ring the sums are rebuilt from scratch so rounding can never accumulate.
+		// Starts from a ring of zeros, so the first length frames ramp up, like the sender always did.
+		class Boxcar : public TemporalFilter
+		{
+		public:
+			Boxcar(unsigned int length) : length(clamplength(length)) { this->reset(); }
+
+			void filter(const float* kPa, float* out)
+			{
+				float* slot = this->ring[this->head];
+				for (unsigned int i = 0; i < NUMPADS; ++i)
+				{
+					this->sum[i] = this->sum[i] - slot[i] + kPa[i]; // the oldest frame is about to be overwritten
+					slot[i] = kPa[i];
+				}
+				this->head = (this->head + 1) % this->length;
+				if (this->head == 0)
+				{
+					for (unsigned int i = 0; i < NUMPADS; ++i)
+					{
+						this->sum[i] = 0;
+						for (unsigned int k = 0; k < this->length; ++k)
+						{
+							this->sum[i] = this->sum[i] + this->ring[k][i];
+						}
+					}
+				}
+				for (unsigned int i = 0; i < NUMPADS; ++i)
+				{
+					out[i] = (float)(this->sum[i] / this->length);
+				}
+			}
+
+			void reset()
+			{
+				memset(this->ring, 0, sizeof(this->ring));
+				memset(this->sum, 0, sizeof(this->sum));
+				this->head = 0;
+			}
+
+			const char* name() { return "boxcar"; }
+
+		private:
+			unsigned int length;
+			unsigned int head; // slot the next frame goes in
+			float ring[MAXFILTERLEN][NUMPADS];
+			double sum[NUMPADS];
+		};
+
+		class Ema : public TemporalFilter
+		{
+		public:
+			Ema(float alpha) : alpha(alpha < 0 ? 0 : (alpha > 1 ? 1 : alpha)) { this->reset(); }
+
+			void filter(const float* kPa, float* out)
+			{
+				if (!this->primed) {
+					memcpy(this->y, kPa, sizeof(this->y));
+					this->primed = true;
+				}
+				for (unsigned int i = 0; i < NUMPADS; ++i)
+				{
+					this->y[i] = this->y[i] + this->alpha * (kPa[i] - this->y[i]);
+					out[i] = this->y[i];
+				}
+			}
+
+			void reset() { this->primed = false; }
+			const char* name() { return "ema"; }
+
+		private:
+			float alpha;
+			bool primed; // y starts at the first frame instead of ramping up from zero
+			float y[NUMPADS];
+		};
+
+		// Weighted sum of the last length frames, weights[0] for the newest. The FIR and Savitzky-Golay filters only differ in their weights
+		class Weighted : public TemporalFilter
+		{
+		public:
+			Weighted(const char* label, const double* weights, unsigned int length) : label(label), length(clamplength(length))
+			{
+				for (unsigned int k = 0; k < this->length; ++k)
+				{
+					this->weights[k] = (float)weights[k];
+				}
+				this->reset();
+			}
+
+			void filter(const float* kPa, float* out)
+			{
+				if (!this->primed) {
+					// As if the first frame had always been there, no ramp up from zero
+					for (unsigned int k = 0; k < this->length; ++k)
+					{
+						memcpy(this->ring[k], kPa, NUMPADS * sizeof(float));
+					}
+					this->primed = true;
+				}
+				memcpy(this->ring[this->head], kPa, NUMPADS * sizeof(float));
+
+				const float* frames[MAXFILTERLEN]; // frames[k] is k frames old
+				unsigned int slot = this->head;
+				for (unsigned int k = 0; k < this->length; ++k)
+				{
+					frames[k] = this->ring[slot];
+					slot = slot == 0 ? this->length - 1 : slot - 1;
+				}
+
+				// A block of pads at a time, so the sums stay in registers while the window is walked
+				for (unsigned int i0 = 0; i0 < NUMPADS; i0 += FILTERBLOCK)
+				{
+					float acc[FILTERBLOCK] = { 0 };
+					for (unsigned int k = 0; k < this->length; ++k)
+					{
+						const float* frame = frames[k] + i0;
+						float w = this->weights[k];
+						for (unsigned int j = 0; j < FILTERBLOCK; ++j)
+						{
+							acc[j] = acc[j] + w * frame[j];
+						}
+					}
+					memcpy(out + i0, acc, sizeof(acc));
+				}
+				this->head = (this->head + 1) % this->length;
+			}
+
+			void reset()
+			{
+				this->primed = false;
+				this->head = 0;
+			}
+
+			const char* name() { return this->label; }
+
+		private:
+			const char* label;
+			unsigned int length;
+			unsigned int head; // slot the next frame goes in
+			bool primed;
+			float weights[MAXFILTERLEN];
+			float ring[MAXFILTERLEN][NUMPADS];
+		};
+
+		class OneEuro : public TemporalFilter
+		{
+		public:
+			OneEuro(const FilterParams& params)
+				: mincutoff(params.mincutoff), beta(params.beta), rate(params.rate > 0 ? params.rate : 250)
+			{
+				this->dalpha = this->alpha(params.dcutoff);
+				this->reset();
+			}
+
+			void filter(const float* kPa, float* out)
+			{
+				if (!this->primed) {
+					memcpy(this->x, kPa, sizeof(this->x));
+					memset(this->dx, 0, sizeof(this->dx));
+					this->primed = true;
+				}
+				for (unsigned int i = 0; i < NUMPADS; ++i)
+				{
+					// Smoothed rate of change decides the cutoff: still pads get heavy smoothing, moving ones little lag
+					float d = (kPa[i] - this->x[i]) * this->rate;
+					this->dx[i] = this->dx[i] + this->dalpha * (d - this->dx[i]);
+					float a = this->alpha(this->mincutoff + this->beta * std::fabs(this->dx[i]));
+					this->x[i] = this->x[i] + a * (kPa[i] - this->x[i]);
+					out[i] = this->x[i];
+				}
+			}
+
+			void reset() { this->primed = false; }
+			const char* name() { return "oneeuro"; }
+
+		private:
+			float alpha(float cutoff)
+				//  EMA weight that gives a first order low pass at cutoff [Hz]
+			{
+				return 1.0f / (1.0f + this->rate / (2 * (float)PI * cutoff));
+			}
+
+			float mincutoff, beta, rate, dalpha;
+			bool primed;
+			float x[NUMPADS];
+			float dx[NUMPADS];
+		};
+
+		// Causal FIR weights, falling off linearly with age: newest length, oldest 1
+		void firweights(unsigned int length, double* weights)
+		{
+			double total = 0;
+			for (unsigned int k = 0; k < length; ++k)
+			{
+				weights[k] = length - k;
+				total = total + weights[k];
+			}
+			for (unsigned int k = 0; k < length; ++k)
+			{
+				weights[k] = weights[k] / total;
+			}
+		}
+
+		// Least squares fit of a polynomial of degree order to samples at t = 0, -1, ... -(length-1), evaluated at t = 0.
+		// That is linear in the samples, weights[k] is the row of the fit's pseudo inverse that gives the constant term.
+		void savgolweights(unsigned int length, unsigned int order, double* weights)
+		{
+			if (order >= length) {
+				order = length - 1;
+			}
+			if (order > 4) {
+				order = 4;
+			}
+			unsigned int n = order + 1;
+			double m[5][6]; // normal equations with e0 as the right hand side
+			for (unsigned int i = 0; i < n; ++i)
+			{
+				for (unsigned int j = 0; j < n; ++j)
+				{
+					m[i][j] = 0;
+					for (unsigned int k = 0; k < length; ++k)
+					{
+						m[i][j] = m[i][j] + std::pow(-(double)k, (double)(i + j));
+					}
+				}
+				m[i][n] = i == 0 ? 1 : 0;
+			}
+			for (unsigned int c = 0; c < n; ++c)
+			{
+				unsigned int pivot = c;
+				for (unsigned int r = c + 1; r < n; ++r)
+				{
+					if (std::fabs(m[r][c]) > std::fabs(m[pivot][c])) {
+						pivot = r;
+					}
+				}
+				for (unsigned int j = 0; j <= n; ++j)
+				{
+					double t = m[c][j];
+					m[c][j] = m[pivot][j];
+					m[pivot][j] = t;
+				}
+				for (unsigned int r = 0; r < n; ++r)
+				{
+					if (r == c) {
+						continue;
+					}
+					double f = m[r][c] / m[c][c];
+					for (unsigned int j = c; j <= n; ++j)
+					{
+						m[r][j] = m[r][j] - f * m[c][j];
+					}
+				}
+			}
+			for (unsigned int k = 0; k < length; ++k)
+			{
+				weights[k] = 0;
+				for (unsigned int j = 0; j < n; ++j)
+				{
+					weights[k] = weights[k] + m[j][n] / m[j][j] * std::pow(-(double)k, (double)j);
+				}
+			}
+		}
+	}
+
+	TemporalFilter* makeFilter(const FilterParams& params)
+	{
+		double weights[MAXFILTERLEN];
+		unsigned int length = clamplength(params.length);
+		switch (params.kind)
+		{
+		case FILTER_NONE:
+			return new PassThrough();
+		case FILTER_EMA:
+			return new Ema(params.alpha);
+		case FILTER_FIR:
+			firweights(length, weights);
+			return new Weighted("fir", weights, length);
+		case FILTER_ONEEURO:
+			return new OneEuro(params);
+		case FILTER_SAVGOL:
+			savgolweights(length, params.order, weights);
+			return new Weighted("savgol", weights, length);
+		case FILTER_BOXCAR:
+		default:
+			return new Boxcar(length);
+		}
+	}
+
+	bool parseFilter(const std::string& spec, FilterParams& params)
+	{
+		// Name, then up to three numbers separated by ':'
+		std::string name = spec.substr(0, spec.find(':'));
+		double numbers[3];
+		unsigned int count = 0;
+		size_t colon = spec.find(':');
+		while (colon != std::string::npos && count < 3)
+		{
+			const char* start = spec.c_str() + colon + 1;
+			char* end;
+			numbers[count] = strtod(start, &end);
+			if (end == start) {
+				return false;
+			}
+			++count;
+			colon = spec.find(':', colon + 1);
+		}
+
+		FilterParams parsed = params;
+		if (name == "none") {
+			parsed.kind = FILTER_NONE;
+		}
+		else if (name == "boxcar" || name == "fir") {
+			parsed.kind = name == "boxcar" ? FILTER_BOXCAR : FILTER_FIR;
+			if (count > 0) {
+				if (!(numbers[0] >= 1)) {
+					return false; // also NaN, and negative lengths that don't convert to unsigned
+				}
+				parsed.length = (unsigned int)std::min(numbers[0], (double)MAXFILTERLEN);
+			}
+		}
+		else if (name == "ema") {
+			parsed.kind = FILTER_EMA;
+			if (count > 0 && !(numbers[0] > 0 && numbers[0] <= 1)) {
+				return false; // 0 would freeze the output, above 1 it overshoots and diverges
+			}
+			if (count > 0) parsed.alpha = (float)numbers[0];
+		}
+		else if (name == "oneeuro") {
+			parsed.kind = FILTER_ONEEURO;
+			if ((count > 0 && !(numbers[0] > 0)) || (count > 1 && !(numbers[1] >= 0)) || (count > 2 && !(numbers[2] > 0))) {
+				return false; // a cutoff of 0 or below gives an EMA weight that freezes the output or flips its sign
+			}
+			if (count > 0) parsed.mincutoff = (float)numbers[0];
+			if (count > 1) parsed.beta = (float)numbers[1];
+			if (count > 2) parsed.dcutoff = (float)numbers[2];
+		}
+		else if (name == "savgol") {
+			parsed.kind = FILTER_SAVGOL;
+			if ((count > 0 && !(numbers[0] >= 1)) || (count > 1 && !(numbers[1] >= 0))) {
+				return false;
+			}
+			if (count > 0) parsed.length = (unsigned int)std::min(numbers[0], (double)MAXFILTERLEN);
+			if (count > 1) parsed.order = (unsigned int)std::min(numbers[1], (double)MAXFILTERLEN);
+		}
+		else {
+			return false;
+		}
+		params = parsed;
+		return true;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+
+#include "TactilusKinetics.h"
+
+#define MAXFILTERLEN 64 // longest window a boxcar, FIR or Savitzky-Golay filter can have
+
+namespace tactilus_udp {
+	enum FilterKind
+	{
+		FILTER_NONE, // pass-through, no delay
+		FILTER_BOXCAR, // average of the last length frames, what the sender always did (length 32)
+		FILTER_EMA, // exponential moving average, y += alpha * (x - y)
+		FILTER_FIR, // short causal FIR over the last length frames, weights falling off linearly with age
+		FILTER_ONEEURO, // one-euro filter: EMA whose cutoff rises with how fast the pad's pressure is changing
+		FILTER_SAVGOL // causal Savitzky-Golay: polynomial of degree order fitted to the last length frames, taken at the newest
+	};
+
+	// Which temporal filter runs over each pad and its settings, unused settings are ignored
+	struct FilterParams
+	{
+		FilterKind kind = FILTER_BOXCAR;
+		unsigned int length = 32; // frames in the window (boxcar, fir, savgol)
+		unsigned int order = 2; // polynomial degree (savgol)
+		float alpha = 0.3f; // weight of the newest frame (ema)
+		float mincutoff = 1.0f; // cutoff when the pressure holds still [Hz] (oneeuro)
+		float beta = 0.05f; // how much the cutoff rises per kPa/s of change (oneeuro)
+		float dcutoff = 1.0f; // cutoff of the rate of change estimate [Hz] (oneeuro)
+		float rate = 0; // frames per second the filter runs at [Hz] (oneeuro), 0 for the source's scan rate, or 250 if it can't tell
+	};
+
+	// Filters each pad of consecutive 16x8 frames over time. O(pads) per frame, O(pads*length) for the FIR and Savitzky-Golay ones
+	class TemporalFilter
+	{
+	public:
+		virtual ~TemporalFilter() {}
+
+		virtual void filter(const float* kPa, float* out) = 0;
+		//  Takes the newest frame and writes the filtered frame, both NUMPADS pressures. out may be kPa
+
+		virtual void reset() = 0;
+		//  Forgets every frame seen so far
+
+		virtual const char* name() = 0;
+	};
+
+	TemporalFilter* makeFilter(const FilterParams& params);
+	//  New filter as described by params, lengths are clamped to 1..MAXFILTERLEN
+
+	bool parseFilter(const std::string& spec, FilterParams& params);
+	//  Reads a filter from text as sent in the handshake: "none", "boxcar[:length]", "ema[:alpha]", "fir[:length]",
+	//  "oneeuro[:mincutoff[:beta[:dcutoff]]]" or "savgol[:length[:order]]". Settings left out keep their value in params
+	//  Returns false (leaving params alone) if spec isn't one of these, or gives a length below 1, a negative order, an alpha
+	//  outside (0, 1], a mincutoff or dcutoff that isn't positive or a negative beta
+};
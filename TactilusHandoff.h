@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+
+// Wait-free handoffs between one producer thread and one consumer thread.
+// TripleBuffer passes on only the latest value, SpscQueue passes on every value through a bounded FIFO.
+
+namespace tactilus_udp {
+	// There are three buffers: the producer writes into its own, then swaps it with the middle one,
+	// the consumer swaps its own with the middle one when there is something new. Neither side ever
+	// waits on the other, and the consumer always reads a complete value, never one being written.
+	template <typename T>
+	class TripleBuffer
+	{
+	public:
+		TripleBuffer() : middle(1), back(0), front(2) {}
+
+		T& writebuffer()
+			//  Producer only: the buffer to fill in before publish()
+		{
+			return buffers[back];
+		}
+
+		void publish()
+			//  Producer only: makes the filled in writebuffer() the latest value, and hands back a free buffer to write next
+		{
+			back = middle.exchange(back | NEWBIT, std::memory_order_acq_rel) & INDEXMASK;
+		}
+
+		bool fetch()
+			//  Consumer only: if something was published since the last fetch, makes it readbuffer() and returns true
+		{
+			if ((middle.load(std::memory_order_relaxed) & NEWBIT) == 0) {
+				return false;
+			}
+			front = middle.exchange(front, std::memory_order_acq_rel) & INDEXMASK;
+			return true;
+		}
+
+		const T& readbuffer() const
+			//  Consumer only: the latest value as of the last fetch(), stays untouched until the next fetch()
+		{
+			return buffers[front];
+		}
+
+	private:
+		static const unsigned int INDEXMASK = 3;
+		static const unsigned int NEWBIT = 4; // set in middle when the producer published and the consumer hasn't fetched
+
+		T buffers[3];
+		std::atomic<unsigned int> middle; // index of the buffer between the two sides, plus NEWBIT
+		unsigned int back; // index the producer writes to
+		unsigned int front; // index the consumer reads from
+	};
+};
+
+namespace tactilus_udp {
+	// Bounded lock-free FIFO between one producer thread and one consumer thread, N slots stored inline.
+	// Both sides work on the slots in place: the producer fills writeslot() then push()es it,
+	// the consumer uses readslot() then pop()s it. Neither ever blocks, a full or empty queue gives NULL.
+	template <typename T, unsigned int N>
+	class SpscQueue
+	{
+	public:
+		SpscQueue() : head(0), tail(0) {}
+
+		T* writeslot()
+			//  Producer only: the slot to fill in before push(), NULL if the queue is full
+		{
+			unsigned long t = tail.load(std::memory_order_relaxed);
+			if (t - head.load(std::memory_order_acquire) == N) {
+				return NULL;
+			}
+			return &buffers[t % N];
+		}
+
+		void push()
+			//  Producer only: hands the filled in writeslot() to the consumer
+		{
+			tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+		T* readslot()
+			//  Consumer only: the oldest pushed slot, NULL if the queue is empty. Stays valid until pop()
+		{
+			unsigned long h = head.load(std::memory_order_relaxed);
+			if (tail.load(std::memory_order_acquire) == h) {
+				return NULL;
+			}
+			return &buffers[h % N];
+		}
+
+		void pop()
+			//  Consumer only: gives the readslot() back to the producer
+		{
+			head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+		unsigned int size() const
+			//  Slots in use, only exact on the producer or consumer thread
+		{
+			return (unsigned int)(tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire));
+		}
+
+	private:
+		T buffers[N];
+		std::atomic<unsigned long> head; // slots popped so far
+		std::atomic<unsigned long> tail; // slots pushed so far
+	};
+};
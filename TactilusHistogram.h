@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// HDR-style histogram: values below 16 are counted exactly, above that every power of two is split into 16
+// buckets, so any percentile is within ~6% of the true value and recording is a single counter increment.
+// record() may be called from any thread while another thread reads percentiles.
+
+namespace tactilus_udp {
+	class Histogram
+	{
+	public:
+		Histogram() { reset(); }
+
+		void record(uint64_t value)
+		{
+			buckets[bucketof(value)].fetch_add(1, std::memory_order_relaxed);
+			total.fetch_add(1, std::memory_order_relaxed);
+			sum.fetch_add(value, std::memory_order_relaxed);
+			uint64_t m = maximum.load(std::memory_order_relaxed);
+			while (value > m && !maximum.compare_exchange_weak(m, value, std::memory_order_relaxed)) {}
+		}
+
+		void reset()
+		{
+			for (unsigned int i = 0; i < NUMBUCKETS; ++i)
+			{
+				buckets[i].store(0, std::memory_order_relaxed);
+			}
+			total.store(0, std::memory_order_relaxed);
+			sum.store(0, std::memory_order_relaxed);
+			maximum.store(0, std::memory_order_relaxed);
+		}
+
+		uint64_t count() const { return total.load(std::memory_order_relaxed); }
+		uint64_t max() const { return maximum.load(std::memory_order_relaxed); }
+		double mean() const { uint64_t n = count(); return n == 0 ? 0 : (double)sum.load(std::memory_order_relaxed) / n; }
+
+		uint64_t percentile(double p) const
+			//  Value below which p percent (0-100) of the recorded values fall, 0 if nothing was recorded
+		{
+			uint64_t n = count();
+			if (n == 0) {
+				return 0;
+			}
+			uint64_t rank = (uint64_t)(p / 100.0 * n + 0.5);
+			if (rank < 1) {
+				rank = 1;
+			}
+			uint64_t seen = 0;
+			for (unsigned int i = 0; i < NUMBUCKETS; ++i)
+			{
+				seen = seen + buckets[i].load(std::memory_order_relaxed);
+				if (seen >= rank) {
+					uint64_t v = valueof(i);
+					return v < max() ? v : max();
+				}
+			}
+			return max();
+		}
+
+	private:
+		static const unsigned int SUBBITS = 4;
+		static const unsigned int SUBBUCKETS = 1 << SUBBITS;
+		static const unsigned int NUMBUCKETS = SUBBUCKETS + (64 - SUBBITS) * SUBBUCKETS;
+
+		static unsigned int msb(uint64_t v)
+		{
+			unsigned int m = 0;
+			for (unsigned int step = 32; step > 0; step /= 2)
+			{
+				if (v >> step) {
+					v >>= step;
+					m += step;
+				}
+			}
+			return m;
+		}
+
+		static unsigned int bucketof(uint64_t v)
+		{
+			if (v < SUBBUCKETS) {
+				return (unsigned int)v;
+			}
+			unsigned int m = msb(v);
+			return SUBBUCKETS + (m - SUBBITS) * SUBBUCKETS + (unsigned int)((v >> (m - SUBBITS)) - SUBBUCKETS);
+		}
+
+		static uint64_t valueof(unsigned int bucket)
+			//  Middle of the range of values that land in bucket
+		{
+			if (bucket < SUBBUCKETS) {
+				return bucket;
+			}
+			unsigned int m = (bucket - SUBBUCKETS) / SUBBUCKETS + SUBBITS;
+			uint64_t sub = (bucket - SUBBUCKETS) % SUBBUCKETS + SUBBUCKETS;
+			uint64_t lower = sub << (m - SUBBITS);
+			return lower + (((uint64_t)1 << (m - SUBBITS)) >> 1);
+		}
+
+		std::atomic<uint64_t> buckets[NUMBUCKETS];
+		std::atomic<uint64_t> total;
+		std::atomic<uint64_t> sum;
+		std::atomic<uint64_t> maximum;
+	};
+};
@@ -0,0 +1,157 @@
+#include "TactilusKinetics.h"
+#include "TactilusPacket.h"
+
+namespace tactilus_udp
+{
+	double KineticsResult::momentyat(double x1) const
+		//  Same as momenty but about x1, x should go from back of foot to front of foot
+	{
+		if (force == 0) {
+			return 0; // Likely means no pressure on sensor at all
+		}
+		// (r * 17.2 + 17.2 / 2.0) are the -x center locations of pads, so sum(f * x) = 270 * force - 17.2 * (sumfr + force / 2)
+		double sumfx = INSOLELENGTH * force - PADLENGTH * (sumfr + force / 2.0);
+		return -(sumfx - x1 * force) / 1000.0; // Divide by 1000 to get Nm
+	}
+
+	double KineticsResult::momentxat(double y1) const
+		//  Same as momentx but about y1, y should go from inside of foot to outside of foot
+	{
+		if (force == 0) {
+			return 0; // Likely means no pressure on sensor at all
+		}
+		// (c * 13.0 + 13.0 / 2.0) are the -y center locations of pads
+		double sumfy = INSOLEWIDTH * force - PADWIDTH * (sumfc + force / 2.0);
+		return (sumfy - y1 * force) / 1000.0;
+	}
+
+	namespace
+	{
+		// What a kernel sweeps for besides the total force, each bit serves some of the PacketFields
+		enum KineticsParts
+		{
+			PART_ROWS = 1, // sum of force times row: copx, momenty
+			PART_COLS = 2, // sum of force times column: copy, momentx
+			PART_FRONT = 4, // front/back forces
+			PART_CONTACT = 8, // contact area
+			PART_PEAK = 16, // peak pressure
+			ALLPARTS = 31
+		};
+
+		// computeKinetics with everything PARTS leaves out compiled away, those outputs come out as 0
+		template <unsigned int PARTS>
+		void kineticsFor(const float* kPa, const double areas[PADROWS][PADCOLS], const KineticsRequest& req, KineticsResult& res)
+		{
+			double force = 0;
+			double sumfr = 0;
+			double sumfc = 0;
+			double frontforce = 0;
+			double contactarea = 0;
+			float peakkPa = 0;
+			int head = 0;
+
+			for (unsigned int r = 0; r < PADROWS; ++r)
+			{
+				// mm^2 * kPa gives mN, the row sums are turned into Newtons once instead of every pad
+				double rowforce = 0;
+				double rowfc = 0;
+				for (unsigned int c = 0; c < PADCOLS; ++c, ++head)
+				{
+					double padforce = areas[r][c] * kPa[head];
+					rowforce = rowforce + padforce;
+					if (PARTS & PART_COLS) {
+						rowfc = rowfc + padforce * c;
+					}
+					if ((PARTS & PART_CONTACT) && kPa[head] > req.contactkPa) {
+						contactarea = contactarea + areas[r][c];
+					}
+					if ((PARTS & PART_PEAK) && kPa[head] > peakkPa) {
+						peakkPa = kPa[head];
+					}
+				}
+				rowforce = rowforce / 1000.0;
+				force = force + rowforce;
+				if (PARTS & PART_COLS) {
+					sumfc = sumfc + rowfc / 1000.0;
+				}
+				if (PARTS & PART_ROWS) {
+					sumfr = sumfr + rowforce * r;
+				}
+				if ((PARTS & PART_FRONT) && r < PADROWS / 2) {
+					frontforce = frontforce + rowforce;
+				}
+			}
+
+			res.force = force;
+			res.sumfr = sumfr;
+			res.sumfc = sumfc;
+			res.frontforce = frontforce;
+			res.backforce = (PARTS & PART_FRONT) ? force - frontforce : 0;
+			res.contactarea = contactarea;
+			res.peakkPa = peakkPa;
+			if (force == 0) {
+				res.copx = 0; // Likely means no pressure on sensor at all
+				res.copy = 0;
+			}
+			else {
+				res.copx = (PARTS & PART_ROWS) ? INSOLELENGTH - PADLENGTH * (sumfr / force + 0.5) : 0;
+				res.copy = (PARTS & PART_COLS) ? INSOLEWIDTH - PADWIDTH * (sumfc / force + 0.5) : 0;
+			}
+			res.momenty = (PARTS & PART_ROWS) ? res.momentyat(req.x1) : 0;
+			res.momentx = (PARTS & PART_COLS) ? res.momentxat(req.y1) : 0;
+
+			res.padnumber = req.padnumber < MAXPADREQ ? req.padnumber : MAXPADREQ;
+			for (unsigned int j = 0; j < res.padnumber; ++j)
+			{
+				if (req.padx[j] < PADROWS && req.pady[j] < PADCOLS) {
+					res.padforces[j] = areas[req.padx[j]][req.pady[j]] * kPa[req.padx[j] * PADCOLS + req.pady[j]] / 1000.0;
+				}
+				else {
+					res.padforces[j] = 0;
+				}
+			}
+		}
+
+		const KineticsKernel kernels[ALLPARTS + 1] = {
+			kineticsFor<0>, kineticsFor<1>, kineticsFor<2>, kineticsFor<3>, kineticsFor<4>, kineticsFor<5>, kineticsFor<6>, kineticsFor<7>,
+			kineticsFor<8>, kineticsFor<9>, kineticsFor<10>, kineticsFor<11>, kineticsFor<12>, kineticsFor<13>, kineticsFor<14>, kineticsFor<15>,
+			kineticsFor<16>, kineticsFor<17>, kineticsFor<18>, kineticsFor<19>, kineticsFor<20>, kineticsFor<21>, kineticsFor<22>, kineticsFor<23>,
+			kineticsFor<24>, kineticsFor<25>, kineticsFor<26>, kineticsFor<27>, kineticsFor<28>, kineticsFor<29>, kineticsFor<30>, kineticsFor<31>
+		};
+	}
+
+	void computeKinetics(const float* kPa, const double areas[PADROWS][PADCOLS], const KineticsRequest& req, KineticsResult& res)
+	{
+		kineticsFor<ALLPARTS>(kPa, areas, req, res);
+	}
+
+	KineticsKernel kineticsKernel(uint32_t fields)
+	{
+		unsigned int parts = 0;
+		if (fields & (FIELD_MOMENTY | FIELD_COPX)) parts = parts | PART_ROWS;
+		if (fields & (FIELD_MOMENTX | FIELD_COPY)) parts = parts | PART_COLS;
+		if (fields & (FIELD_FRONTFORCE | FIELD_BACKFORCE)) parts = parts | PART_FRONT;
+		if (fields & FIELD_CONTACTAREA) parts = parts | PART_CONTACT;
+		if (fields & FIELD_PEAKKPA) parts = parts | PART_PEAK;
+		return kernels[parts];
+	}
+
+	unsigned int packKinetics(const KineticsResult& res, uint32_t fields, float* values)
+	{
+		unsigned int n = 0;
+		if (fields & FIELD_FORCE) { values[n++] = (float)res.force; }
+		if (fields & FIELD_MOMENTY) { values[n++] = (float)res.momenty; }
+		if (fields & FIELD_MOMENTX) { values[n++] = (float)res.momentx; }
+		if (fields & FIELD_FRONTFORCE) { values[n++] = (float)res.frontforce; }
+		if (fields & FIELD_BACKFORCE) { values[n++] = (float)res.backforce; }
+		if (fields & FIELD_COPX) { values[n++] = (float)res.copx; }
+		if (fields & FIELD_COPY) { values[n++] = (float)res.copy; }
+		if (fields & FIELD_CONTACTAREA) { values[n++] = (float)res.contactarea; }
+		if (fields & FIELD_PEAKKPA) { values[n++] = res.peakkPa; }
+		for (unsigned int j = 0; j < MAXPADREQ; ++j)
+		{
+			if (fields & (FIELD_PAD0 << j)) { values[n++] = j < res.padnumber ? (float)res.padforces[j] : 0; }
+		}
+		return n;
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+#define PADROWS 16
+#define PADCOLS 8
+#define NUMPADS 128
+#define MAXPADREQ 16 // max number of individual pad forces that can be requested at once
+
+#define PADLENGTH 17.2 // length of a pad along x [mm]
+#define PADWIDTH 13.0 // width of a pad along y [mm]
+#define INSOLELENGTH 270.0 // x location of the front edge of the pad array [mm]
+#define INSOLEWIDTH 100.0 // y location of the inside edge of the pad array [mm]
+
+namespace tactilus_udp {
+	// Options for computeKinetics. Force, CoP, moments, front/back forces, contact area and peak pressure are always filled in.
+	struct KineticsRequest
+	{
+		double x1 = 0; // x location [mm] of the point the moment about y is taken at, x_max should be 270 mm
+		double y1 = 0; // y location [mm] of the point the moment about x is taken at, y_max should be 100 mm
+		unsigned int padx[MAXPADREQ] = { 0 }; // rows of the pads whose individual forces are wanted
+		unsigned int pady[MAXPADREQ] = { 0 }; // columns of the pads whose individual forces are wanted
+		unsigned int padnumber = 0; // how many entries of padx/pady are used
+		float contactkPa = 0; // pads above this pressure count towards contactarea
+	};
+
+	// Everything computeKinetics gets out of one sweep of a 16x8 frame
+	struct KineticsResult
+	{
+		double force; // total force [N]
+		double sumfr; // sum of pad forces times their row index [N], what CoP and moments are derived from
+		double sumfc; // sum of pad forces times their column index [N]
+		double copx; // center of pressure along x, from back to front of foot [mm]
+		double copy; // center of pressure along y, from inside to outside of foot [mm]
+		double momenty; // moment about y axis at KineticsRequest::x1 [Nm]
+		double momentx; // moment about x axis at KineticsRequest::y1 [Nm]
+		double frontforce; // force on the front 64 pads (rows 0-7) [N]
+		double backforce; // force on the back 64 pads (rows 8-15) [N]
+		double padforces[MAXPADREQ]; // forces of the pads requested in KineticsRequest::padx/pady [N]
+		unsigned int padnumber; // how many entries of padforces are filled in
+		double contactarea; // area of the pads above KineticsRequest::contactkPa [mm^2]
+		float peakkPa; // highest pad pressure in the frame [kPa]
+
+		double momentyat(double x1) const;
+		//  Moment about y axis at any x1 [Nm], without another sweep over the frame
+
+		double momentxat(double y1) const;
+		//  Moment about x axis at any y1 [Nm], without another sweep over the frame
+	};
+
+	void computeKinetics(const float* kPa, const double areas[PADROWS][PADCOLS], const KineticsRequest& req, KineticsResult& res);
+	//  Fused kernel: one pass over a 16x8 frame of pressures [kPa] with pad areas [mm^2] fills every field of res
+	//  NOTE: be careful of the signs of moments! They may not be consistent depending on which foot.
+
+	typedef void (*KineticsKernel)(const float* kPa, const double areas[PADROWS][PADCOLS], const KineticsRequest& req, KineticsResult& res);
+
+	KineticsKernel kineticsKernel(uint32_t fields);
+	//  computeKinetics specialised for a packet field mask (PacketField bits): the kernel only sums what those fields need and
+	//  everything else in res comes out 0. force and the requested pad forces are always filled in, momentyat() and momentxat()
+	//  only work if a moment or CoP along that axis was asked for. Look it up once, e.g. when the handshake arrives
+
+	unsigned int packKinetics(const KineticsResult& res, uint32_t fields, float* values);
+	//  Writes the quantities selected by the PacketField bits in fields to values, in increasing bit order. Returns how many were written
+	//  FIELD_PAD0 << j is padforces[j], 0 if fewer pads were requested
+};
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "TactilusPacket.h"
+
+// Whole pressure maps in a packet, after the kinetics. A version 3 packet is a version 2 packet with, for every sensor:
+//   byte 0    MAPKEY or MAPDELTA
+//   then      the 16x8 pads row by row as little-endian int16 tokens: each pad's pressure in 1/MAPSCALE kPa (MAPKEY)
+//             or its change since the sensor's map in the previous packet (MAPDELTA). MAPZERORUN followed by one byte n
+//             stands for n pads of 0 in a row, so unloaded pads and pads that didn't change take almost nothing.
+// The encoder can send pads below a floor and pads with no area as 0, so they compress too.
+// A frame is at most 257 bytes per sensor, two sensors always fit in one MTU sized datagram.
+// Deltas only decode on top of the previous packet, so a keyframe goes out every keyinterval packets to recover from loss.
+
+#define PACKETVERSION_MAP 3
+#define MAPPADS 128 // pads in a map, 16 rows of 8
+#define MAPSCALE 20 // quantisation steps per kPa, 0.05 kPa resolution up to 1638 kPa
+#define MAPKEY 0
+#define MAPDELTA 1
+#define MAPZERORUN (-32768) // token for a run of zeros, the run length follows in one byte
+#define MAPKEYINTERVAL 50 // packets between keyframes unless asked otherwise, 0.2 s at 250 Hz
+#define MAXMAPLEN (1 + 2 * MAPPADS) // most bytes one sensor's map can take
+#define MAXMAPPACKETLEN (MAXPACKETLEN + MAXSENSORS * MAXMAPLEN)
+
+namespace tactilus_udp {
+	inline int16_t quantisekPa(float kPa)
+		//  Nearest step of 1/MAPSCALE kPa, clamped to what an int16 token can hold
+	{
+		float q = kPa * MAPSCALE;
+		q = q > 32767 ? 32767 : (q < -32767 ? -32767 : q);
+		return (int16_t)(q < 0 ? q - 0.5f : q + 0.5f); // the cast truncates towards 0
+	}
+
+	// Appends maps to packets, keeps the last map of each sensor to take deltas against
+	class MapEncoder
+	{
+	public:
+		MapEncoder() : keyinterval(1), sincekey(0), sensors(0), floorkPa(0) {}
+
+		void setkeyinterval(unsigned int packets)
+			//  A keyframe every packets packets, 1 for nothing but keyframes
+		{
+			this->keyinterval = packets < 1 ? 1 : packets;
+			this->sincekey = 0;
+		}
+
+		void setfloor(float kPa)
+			//  Pads below kPa count as unloaded and go out as 0, so they compress into zero runs. 0 (the default) sends them as they are
+		{
+			this->floorkPa = kPa;
+			this->sincekey = 0;
+		}
+
+		void setdead(unsigned int pad, bool dead)
+			//  Whether pad (row * 8 + column) always goes out as 0, e.g. because it carries no area in the kinetics
+		{
+			if (pad < MAPPADS) {
+				this->dead[pad] = dead;
+				this->sincekey = 0;
+			}
+		}
+
+		int append(unsigned char* buf, int len, unsigned int buflen, unsigned int sensors, const float* const* kPa)
+			//  buf holds a len byte packet from encodePacket() for sensors sensors, the maps kPa[0..sensors-1] (MAPPADS each) go after it
+			//  Returns the new length, or -1 if it doesn't fit (buflen MAXMAPPACKETLEN always does) or len isn't a packet
+		{
+			if (len < PACKETHEADERLEN || sensors > MAXSENSORS) {
+				return -1;
+			}
+			bool key = this->sincekey == 0 || sensors != this->sensors;
+			unsigned int at = (unsigned int)len;
+			for (unsigned int s = 0; s < sensors; ++s)
+			{
+				int16_t q[MAPPADS];
+				int16_t delta[MAPPADS];
+				bool fits = true;
+				for (unsigned int i = 0; i < MAPPADS; ++i)
+				{
+					q[i] = this->dead[i] || kPa[s][i] < this->floorkPa ? 0 : quantisekPa(kPa[s][i]);
+					int d = (int)q[i] - (int)this->previous[s][i];
+					fits = fits && d >= -32767 && d <= 32767;
+					delta[i] = (int16_t)d;
+				}
+				bool delta_ok = !key && fits; // a jump too big for a token makes this sensor a keyframe
+				if (buflen < at + MAXMAPLEN) {
+					return -1;
+				}
+				buf[at] = delta_ok ? MAPDELTA : MAPKEY;
+				at = at + 1 + writeTokens(buf + at + 1, delta_ok ? delta : q);
+				memcpy(this->previous[s], q, sizeof(q));
+			}
+			this->sensors = sensors;
+			this->sincekey = (this->sincekey + 1) % this->keyinterval;
+			buf[2] = PACKETVERSION_MAP;
+			return (int)at;
+		}
+
+	private:
+		static unsigned int writeTokens(unsigned char* p, const int16_t* v)
+			//  The MAPPADS values as tokens, runs of two or more zeros as MAPZERORUN n. Returns the bytes written
+		{
+			unsigned int n = 0;
+			unsigned int i = 0;
+			while (i < MAPPADS)
+			{
+				unsigned int run = 0;
+				while (i + run < MAPPADS && v[i + run] == 0 && run < 255)
+				{
+					++run;
+				}
+				if (run >= 2) {
+					p[n] = (unsigned char)(MAPZERORUN & 0xff);
+					p[n + 1] = (unsigned char)((MAPZERORUN >> 8) & 0xff);
+					p[n + 2] = (unsigned char)run;
+					n = n + 3;
+					i = i + run;
+					continue;
+				}
+				p[n] = (unsigned char)(v[i] & 0xff);
+				p[n + 1] = (unsigned char)((v[i] >> 8) & 0xff);
+				n = n + 2;
+				++i;
+			}
+			return n;
+		}
+
+		unsigned int keyinterval;
+		unsigned int sincekey; // packets since the last keyframe
+		unsigned int sensors; // in the last packet, a change forces a keyframe
+		int16_t previous[MAXSENSORS][MAPPADS] = {}; // quantised maps of the last packet
+		float floorkPa;
+		bool dead[MAPPADS] = {};
+	};
+
+	// Reads the maps of consecutive packets from one sender, keeps each sensor's last map to apply deltas to
+	class MapDecoder
+	{
+	public:
+		MapDecoder() : sensors(0), haveprevious(false), lastseq(0) {}
+
+		int decode(const unsigned char* buf, unsigned int len, float* kPa, unsigned int maxsensors)
+			//  Writes the maps of a version 3 packet to kPa, MAPPADS per sensor for up to maxsensors sensors
+			//  Returns the number of sensors in the packet, -1 if it has no maps or is cut short, and -2 if it holds deltas
+			//  on top of a packet that never arrived (those maps are lost until the next keyframe)
+		{
+			PacketHeader hdr;
+			int nvalues = decodePacket(buf, len, hdr, NULL, 0);
+			if (nvalues < 0 || hdr.version != PACKETVERSION_MAP || hdr.sensors > MAXSENSORS) {
+				return -1;
+			}
+			bool follows = this->haveprevious && hdr.seq == this->lastseq + 1 && hdr.sensors == this->sensors;
+			unsigned int at = PACKETHEADERLEN + 4 * (unsigned int)nvalues;
+			int16_t q[MAXSENSORS][MAPPADS];
+			bool complete = true;
+			for (unsigned int s = 0; s < hdr.sensors; ++s)
+			{
+				if (at >= len) {
+					return -1;
+				}
+				unsigned char mode = buf[at];
+				int used = readTokens(buf + at + 1, len - at - 1, q[s]);
+				if (used < 0 || mode > MAPDELTA) {
+					return -1;
+				}
+				at = at + 1 + used;
+				if (mode == MAPDELTA) {
+					if (!follows) {
+						complete = false;
+						continue;
+					}
+					for (unsigned int i = 0; i < MAPPADS; ++i)
+					{
+						q[s][i] = (int16_t)(this->previous[s][i] + q[s][i]);
+					}
+				}
+			}
+			this->lastseq = hdr.seq;
+			this->sensors = hdr.sensors;
+			this->haveprevious = complete;
+			if (!complete) {
+				return -2;
+			}
+			memcpy(this->previous, q, hdr.sensors * sizeof(q[0]));
+			for (unsigned int s = 0; s < hdr.sensors && s < maxsensors; ++s)
+			{
+				for (unsigned int i = 0; i < MAPPADS; ++i)
+				{
+					kPa[s * MAPPADS + i] = q[s][i] * (1.0f / MAPSCALE);
+				}
+			}
+			return (int)hdr.sensors;
+		}
+
+	private:
+		static int readTokens(const unsigned char* p, unsigned int len, int16_t* v)
+			//  Undoes MapEncoder::writeTokens, returns the bytes read or -1 if they run out or a run overshoots
+		{
+			unsigned int n = 0;
+			unsigned int i = 0;
+			while (i < MAPPADS)
+			{
+				if (n + 2 > len) {
+					return -1;
+				}
+				int16_t t = (int16_t)(p[n] | (p[n + 1] << 8));
+				n = n + 2;
+				if (t != MAPZERORUN) {
+					v[i] = t;
+					++i;
+					continue;
+				}
+				if (n + 1 > len || i + p[n] > MAPPADS) {
+					return -1;
+				}
+				for (unsigned int k = 0; k < p[n]; ++k, ++i)
+				{
+					v[i] = 0;
+				}
+				n = n + 1;
+			}
+			return (int)n;
+		}
+
+		unsigned int sensors; // in the last packet
+		bool haveprevious; // previous holds every sensor's map of packet lastseq
+		uint32_t lastseq;
+		int16_t previous[MAXSENSORS][MAPPADS];
+	};
+};
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// Binary datagram sent from Windows to Linux, shared by both sides.
+// Everything is little-endian whatever the host is:
+//   byte 0-1  magic 'T' 'U'
+//   byte 2    version
+//   byte 3    number of sensors
+//   byte 4-7  field mask, a PacketField bit for each quantity sent per sensor
+//   byte 8-11 sequence number, one more than the previous packet from the same sender
+//   byte 12-19 timestamp of the oldest scan in the packet, in microseconds on the sender's steady clock
+//   byte 20-  float32 payload, sensor by sensor, fields of each sensor in increasing bit order
+// Version 1 packets had no sequence number or timestamp, the payload started at byte 8.
+// Version 3 packets are version 2 packets with whole pressure maps after the payload, see TactilusMap.h.
+
+#define PACKETMAGIC0 'T'
+#define PACKETMAGIC1 'U'
+#define PACKETVERSION 2
+#define PACKETHEADERLEN 20
+#define PACKETHEADERLEN_V1 8
+#define MAXSENSORS 8
+#define MAXFIELDS 16 // the field mask can't have more bits set than this
+#define MAXPACKETLEN (PACKETHEADERLEN + MAXSENSORS * MAXFIELDS * 4)
+
+namespace tactilus_udp {
+	// Bits of the field mask
+	enum PacketField
+	{
+		FIELD_FORCE = 1 << 0, // total force [N]
+		FIELD_MOMENTY = 1 << 1, // moment about y axis at x_des [Nm]
+		FIELD_MOMENTX = 1 << 2, // moment about x axis at y_des [Nm]
+		FIELD_FRONTFORCE = 1 << 3, // force on the front 64 pads [N]
+		FIELD_BACKFORCE = 1 << 4, // force on the back 64 pads [N]
+		FIELD_COPX = 1 << 5, // center of pressure along x [mm]
+		FIELD_COPY = 1 << 6, // center of pressure along y [mm]
+		FIELD_CONTACTAREA = 1 << 7, // loaded area [mm^2]
+		FIELD_PEAKKPA = 1 << 8, // highest pad pressure [kPa]
+		FIELD_PAD0 = 1 << 16, // force of the first pad the receiver asked for [N], bit 16 + j for pad j, up to MAXPADREQ pads
+	};
+
+	// What the sender has always sent: force, moment y, moment x, front force, back force
+	const uint32_t DEFAULTFIELDS = FIELD_FORCE | FIELD_MOMENTY | FIELD_MOMENTX | FIELD_FRONTFORCE | FIELD_BACKFORCE;
+
+	struct PacketHeader
+	{
+		unsigned int version;
+		unsigned int sensors;
+		uint32_t fields;
+		uint32_t seq; // 0 for version 1 packets
+		uint64_t timestampus; // 0 for version 1 packets
+	};
+
+	inline void putu32(unsigned char* p, uint32_t v)
+	{
+		p[0] = (unsigned char)v;
+		p[1] = (unsigned char)(v >> 8);
+		p[2] = (unsigned char)(v >> 16);
+		p[3] = (unsigned char)(v >> 24);
+	}
+
+	inline uint32_t getu32(const unsigned char* p)
+	{
+		return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+	}
+
+	inline void putu64(unsigned char* p, uint64_t v)
+	{
+		putu32(p, (uint32_t)v);
+		putu32(p + 4, (uint32_t)(v >> 32));
+	}
+
+	inline uint64_t getu64(const unsigned char* p)
+	{
+		return (uint64_t)getu32(p) | ((uint64_t)getu32(p + 4) << 32);
+	}
+
+	inline void putf32(unsigned char* p, float f)
+	{
+		uint32_t v;
+		memcpy(&v, &f, sizeof(v));
+		putu32(p, v);
+	}
+
+	inline float getf32(const unsigned char* p)
+	{
+		uint32_t v = getu32(p);
+		float f;
+		memcpy(&f, &v, sizeof(f));
+		return f;
+	}
+
+	inline unsigned int packetFieldCount(uint32_t fields)
+		//  Number of floats each sensor contributes to the payload
+	{
+		unsigned int n = 0;
+		for (; fields != 0; fields &= fields - 1)
+		{
+			++n;
+		}
+		return n;
+	}
+
+	inline bool parseFields(const char* spec, uint32_t& fields)
+		//  Reads a field mask from names joined by '+' as sent in the handshake, e.g. "force+momenty+copx"
+		//  Names are force, momenty, momentx, frontforce, backforce, copx, copy, contactarea, peakkpa and default (DEFAULTFIELDS)
+		//  Pad forces aren't named, asking for pads sets their bits. Returns false (leaving fields alone) if a name isn't known
+	{
+		static const char* names[] = { "force", "momenty", "momentx", "frontforce", "backforce", "copx", "copy", "contactarea", "peakkpa" };
+		uint32_t parsed = 0;
+		while (*spec != '\0')
+		{
+			size_t len = strcspn(spec, "+");
+			bool known = false;
+			for (unsigned int i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+			{
+				if (strlen(names[i]) == len && strncmp(spec, names[i], len) == 0) {
+					parsed = parsed | (1u << i);
+					known = true;
+				}
+			}
+			if (len == 7 && strncmp(spec, "default", len) == 0) {
+				parsed = parsed | DEFAULTFIELDS;
+				known = true;
+			}
+			if (!known) {
+				return false;
+			}
+			spec = spec + len + (spec[len] == '+' ? 1 : 0);
+		}
+		fields = parsed;
+		return true;
+	}
+
+	inline int fieldOffset(uint32_t fields, uint32_t field)
+		//  Where field is among the floats of one sensor in a packet with this field mask, -1 if it isn't sent
+	{
+		if ((fields & field) == 0) {
+			return -1;
+		}
+		return (int)packetFieldCount(fields & (field - 1));
+	}
+
+	inline int encodePacket(unsigned char* buf, unsigned int buflen, unsigned int sensors, uint32_t fields, uint32_t seq, uint64_t timestampus, const float* values)
+		//  values holds sensors * packetFieldCount(fields) floats, sensor by sensor
+		//  Returns the number of bytes written to buf, or -1 if it doesn't fit
+	{
+		unsigned int nvalues = sensors * packetFieldCount(fields);
+		if (sensors > MAXSENSORS || packetFieldCount(fields) > MAXFIELDS || PACKETHEADERLEN + 4 * nvalues > buflen)
+		{
+			return -1;
+		}
+		buf[0] = PACKETMAGIC0;
+		buf[1] = PACKETMAGIC1;
+		buf[2] = PACKETVERSION;
+		buf[3] = (unsigned char)sensors;
+		putu32(buf + 4, fields);
+		putu32(buf + 8, seq);
+		putu64(buf + 12, timestampus);
+		for (unsigned int i = 0; i < nvalues; ++i)
+		{
+			putf32(buf + PACKETHEADERLEN + 4 * i, values[i]);
+		}
+		return PACKETHEADERLEN + 4 * nvalues;
+	}
+
+	inline bool isPacket(const unsigned char* buf, unsigned int len)
+		//  Whether buf starts like one of our binary datagrams (anything else is a text message such as "handshake")
+	{
+		return len >= PACKETHEADERLEN_V1 && buf[0] == PACKETMAGIC0 && buf[1] == PACKETMAGIC1;
+	}
+
+	inline int decodePacket(const unsigned char* buf, unsigned int len, PacketHeader& hdr, float* values, unsigned int maxvalues)
+		//  Reads the header into hdr and up to maxvalues payload floats into values
+		//  Returns the number of floats in the payload, or -1 if buf is not a complete packet of a version we understand
+	{
+		if (!isPacket(buf, len) || buf[2] < 1 || buf[2] > 3) // 3 is PACKETVERSION plus maps, this reads the part before them
+		{
+			return -1;
+		}
+		unsigned int headerlen = buf[2] == 1 ? PACKETHEADERLEN_V1 : PACKETHEADERLEN;
+		if (len < headerlen)
+		{
+			return -1;
+		}
+		hdr.version = buf[2];
+		hdr.sensors = buf[3];
+		hdr.fields = getu32(buf + 4);
+		hdr.seq = buf[2] == 1 ? 0 : getu32(buf + 8);
+		hdr.timestampus = buf[2] == 1 ? 0 : getu64(buf + 12);
+		unsigned int nvalues = hdr.sensors * packetFieldCount(hdr.fields);
+		if (headerlen + 4 * nvalues > len)
+		{
+			return -1;
+		}
+		for (unsigned int i = 0; i < nvalues && i < maxvalues; ++i)
+		{
+			values[i] = getf32(buf + headerlen + 4 * i);
+		}
+		return nvalues;
+	}
+
+	inline unsigned int scanFloats(const char* text, unsigned int len, float* values, unsigned int maxvalues)
+		//  The numbers in comma (or space) separated text, as older senders send it, up to maxvalues of them into values
+		//  Returns how many. Stops at len, at a 0 or at the first thing that isn't a number, like reading it with a stringstream did,
+		//  but without copying the text, allocating or looking at the locale
+	{
+		static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 }; // every power of 10 a double holds exactly
+		const char* p = text;
+		const char* end = text + len;
+		unsigned int n = 0;
+		while (n < maxvalues)
+		{
+			while (p < end && (*p == ',' || *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+			{
+				++p;
+			}
+			bool negative = p < end && *p == '-';
+			if (p < end && (*p == '-' || *p == '+')) {
+				++p;
+			}
+			// Up to 19 significant digits in an integer, and the power of 10 to scale it by
+			uint64_t mantissa = 0;
+			int exponent = 0;
+			unsigned int digits = 0;
+			bool any = false;
+			for (; p < end && *p >= '0' && *p <= '9'; ++p)
+			{
+				any = true;
+				if (digits < 19) {
+					mantissa = mantissa * 10 + (unsigned int)(*p - '0');
+					digits = mantissa == 0 ? 0 : digits + 1;
+				}
+				else {
+					++exponent;
+				}
+			}
+			if (p < end && *p == '.') {
+				for (++p; p < end && *p >= '0' && *p <= '9'; ++p)
+				{
+					any = true;
+					if (digits < 19) {
+						mantissa = mantissa * 10 + (unsigned int)(*p - '0');
+						digits = mantissa == 0 ? 0 : digits + 1;
+						--exponent;
+					}
+				}
+			}
+			if (!any) {
+				break;
+			}
+			if (p < end && (*p == 'e' || *p == 'E')) {
+				const char* q = p + 1;
+				bool negexp = q < end && *q == '-';
+				if (q < end && (*q == '-' || *q == '+')) {
+					++q;
+				}
+				if (q < end && *q >= '0' && *q <= '9') {
+					int e = 0;
+					for (; q < end && *q >= '0' && *q <= '9'; ++q)
+					{
+						e = e < 1000 ? e * 10 + (*q - '0') : e;
+					}
+					exponent = negexp ? exponent - e : exponent + e;
+					p = q;
+				}
+			}
+			double v = (double)mantissa;
+			for (; exponent > 22; exponent -= 22)
+			{
+				v = v * 1e22;
+			}
+			for (; exponent < -22; exponent += 22)
+			{
+				v = v / 1e22;
+			}
+			v = exponent < 0 ? v / pow10[-exponent] : v * pow10[exponent];
+			values[n] = (float)(negative ? -v : v);
+			++n;
+		}
+		return n;
+	}
+};
@@ -0,0 +1,232 @@
+#include "TactilusSender.h"
+
+#include <cstring>
+
+namespace tactilus_udp
+{
+	Sender::Sender(const std::vector<TactilusUDP*>& sensors, const KineticsRequest& req, uint32_t fields)
+		: Sender(sensors, std::vector<KineticsRequest>(sensors.size(), req), fields)
+	{
+	}
+
+	Sender::Sender(const std::vector<TactilusUDP*>& sensors, const std::vector<KineticsRequest>& reqs, uint32_t fields)
+		: sensors(sensors), workers(sensors.size()), lastframe(sensors.size(), 0), frames(sensors.size()), reqs(reqs), fields(fields),
+		kernel(kineticsKernel(fields)), period(0), mapon(false), sequence(0), scantimeus(0),
+		running(false), queued(0), waiters(0), sent(0), skippedframes(0), queuefull(0), encodefailed(0)
+	{
+		for (unsigned int i = 0; i <= SENDQUEUELEN; ++i)
+		{
+			this->queuedepth[i] = 0;
+		}
+
+		// One long-lived acquisition thread per sensor, scanning as fast as the sensor allows, so all of them scan in parallel.
+		// Each worker computes its sensor's kinetics too, so the sensors don't queue up for one thread to do them.
+		this->reqs.resize(this->sensors.size());
+		for (unsigned int i = 0; i < this->sensors.size(); ++i)
+		{
+			TactilusUDP* tact = this->sensors[i];
+			const KineticsRequest* req = &this->reqs[i];
+			KineticsKernel kernel = this->kernel;
+			StageTimes* timing = &this->timing;
+			tact->settiming(timing);
+			this->workers[i] = new AcquisitionWorker([tact, req, kernel, timing](SensorFrame& frame) {
+				tact->update();
+				tact->getframe(frame);
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				tact->estimateKinetics(frame, *req, kernel, frame.kinetics);
+				timing->record(STAGE_KINETICS, start, std::chrono::steady_clock::now());
+			});
+		}
+	}
+
+	Sender::~Sender()
+	{
+		this->stop();
+		for (unsigned int i = 0; i < this->workers.size(); ++i)
+		{
+			delete this->workers[i];
+			this->sensors[i]->settiming(NULL);
+		}
+	}
+
+	void Sender::setrate(double hz)
+	{
+		this->period = hz > 0 ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / hz)) : std::chrono::steady_clock::duration(0);
+	}
+
+	void Sender::setmap(bool on, unsigned int keyinterval, float floorkPa)
+	{
+		this->mapon = on;
+		this->map.setkeyinterval(keyinterval);
+		this->map.setfloor(floorkPa);
+		for (unsigned int pad = 0; pad < MAPPADS; ++pad)
+		{
+			this->map.setdead(pad, this->sensors[0]->getpadarea(pad / PADCOLS, pad % PADCOLS) == 0);
+		}
+	}
+
+	void Sender::start()
+	{
+		for (unsigned int i = 0; i < this->workers.size(); ++i)
+		{
+			this->workers[i]->start();
+		}
+		if (!this->running.exchange(true)) {
+			this->transmitter = std::thread(&Sender::transmit, this);
+		}
+	}
+
+	void Sender::stop()
+	{
+		if (this->running.exchange(false)) {
+			{
+				std::lock_guard<std::mutex> lock(this->mutex);
+			}
+			this->ready.notify_all();
+			this->transmitter.join();
+		}
+		for (unsigned int i = 0; i < this->workers.size(); ++i)
+		{
+			this->workers[i]->stop();
+		}
+	}
+
+	int Sender::buildnext()
+	{
+		if (this->period.count() > 0) {
+			// Waits for this packet's turn before taking the frames, so it goes out with the newest ones
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			if (this->nextsend > now) {
+				std::this_thread::sleep_until(this->nextsend);
+			}
+			this->nextsend = (this->nextsend > now ? this->nextsend : now) + this->period;
+		}
+
+		// Binary packet from TactilusPacket.h: header, then the fields of each sensor as float32
+		for (unsigned int i = 0; i < this->sensors.size(); ++i)
+		{
+			// Waits until this sensor has a frame that hasn't been encoded yet. The worker keeps scanning
+			// into its own buffer meanwhile, frame stays a consistent snapshot until the next waitframe
+			unsigned long previous = this->lastframe[i];
+			this->frames[i] = &this->workers[i]->waitframe(this->lastframe[i]);
+			if (previous != 0 && this->lastframe[i] > previous + 1) {
+				this->skippedframes += this->lastframe[i] - previous - 1;
+			}
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		unsigned int nvalues = 0;
+		for (unsigned int i = 0; i < this->sensors.size(); ++i)
+		{
+			const SensorFrame& frame = *this->frames[i];
+			nvalues = nvalues + packKinetics(frame.kinetics, this->fields, this->values + nvalues);
+			if (i == 0 || frame.scantimeus < this->scantimeus) {
+				this->scantimeus = frame.scantimeus; // the packet is as stale as its oldest scan
+			}
+		}
+
+		int packetlen = encodePacket(this->packet, sizeof(this->packet), (unsigned int)this->sensors.size(), this->fields, (uint32_t)this->sequence, this->scantimeus, this->values);
+		if (this->mapon) {
+			const float* maps[MAXSENSORS];
+			for (unsigned int i = 0; i < this->sensors.size(); ++i)
+			{
+				maps[i] = this->frames[i]->kPa;
+			}
+			packetlen = this->map.append(this->packet, packetlen, sizeof(this->packet), (unsigned int)this->sensors.size(), maps);
+		}
+		++this->sequence;
+		this->timing.record(STAGE_ENCODE, start, std::chrono::steady_clock::now());
+		return packetlen;
+	}
+
+	void Sender::sendnext()
+	{
+		int packetlen = this->buildnext();
+		if (packetlen < 0) {
+			// configure() only asks for fields and maps that fit, so this takes a change there, but a slot can't hold -1 bytes
+			this->encodefailed++;
+			return;
+		}
+
+		unsigned int depth = this->queue.size();
+		this->queuedepth[depth]++;
+		QueuedPacket* slot = this->queue.writeslot();
+		if (slot == NULL) {
+			// The transmit thread is behind by a whole queue, which only happens if sendto() itself stalls
+			this->queuefull++;
+			while ((slot = this->queue.writeslot()) == NULL)
+			{
+				std::this_thread::yield();
+			}
+		}
+		memcpy(slot->data, this->packet, packetlen);
+		slot->len = packetlen;
+		slot->scantimeus = this->scantimeus;
+		this->queue.push();
+		this->queued.store(this->queued.load() + 1);
+		if (this->waiters.load() > 0) {
+			{
+				std::lock_guard<std::mutex> lock(this->mutex);
+			}
+			this->ready.notify_all();
+		}
+	}
+
+	void Sender::transmit()
+	{
+		unsigned long done = 0;
+		while (1)
+		{
+			QueuedPacket* slot = this->queue.readslot();
+			if (slot != NULL) {
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				this->sensors[0]->publish((const char*)slot->data, slot->len);
+				std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+				this->timing.record(STAGE_SEND, start, end);
+				std::chrono::steady_clock::time_point scantime{ std::chrono::microseconds(slot->scantimeus) };
+				this->timing.record(STAGE_AGE, scantime, end);
+				this->queue.pop();
+				++done;
+				this->sent.store(done);
+				continue;
+			}
+			if (!this->running) {
+				return; // only once the queue is empty
+			}
+
+			// Same handshake as AcquisitionWorker::waitframe: waiters goes up before queued is checked,
+			// sendnext() checks waiters after bumping queued, so the wakeup can't be missed
+			this->waiters++;
+			{
+				std::unique_lock<std::mutex> lock(this->mutex);
+				this->ready.wait(lock, [&] { return this->queued.load() > done || !this->running; });
+			}
+			this->waiters--;
+		}
+	}
+
+	const unsigned char* Sender::getpacket()
+	{
+		return this->packet;
+	}
+
+	SenderStats Sender::getstats()
+	{
+		SenderStats stats;
+		stats.packets = this->queued.load();
+		stats.sent = this->sent.load();
+		stats.skippedframes = this->skippedframes.load();
+		stats.queuefull = this->queuefull.load();
+		stats.encodefailed = this->encodefailed.load();
+		for (unsigned int i = 0; i <= SENDQUEUELEN; ++i)
+		{
+			stats.queuedepth[i] = this->queuedepth[i].load();
+		}
+		return stats;
+	}
+
+	StageTimes& Sender::gettiming()
+	{
+		return this->timing;
+	}
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TactilusHandoff.h"
+#include "TactilusKinetics.h"
+#include "TactilusMap.h"
+#include "TactilusPacket.h"
+#include "TactilusTiming.h"
+#include "TactilusUDP.h"
+#include "TactilusWorker.h"
+
+#define SENDQUEUELEN 8 // encoded packets that can wait for the transmit thread
+
+namespace tactilus_udp {
+	// How full the stages of a Sender have been since it started
+	struct SenderStats
+	{
+		unsigned long packets; // encoded by sendnext()
+		unsigned long sent; // handed to sendto() by the transmit thread
+		unsigned long skippedframes; // frames a worker published that a newer one replaced before they were encoded
+		unsigned long queuefull; // times sendnext() found the transmit queue full and had to wait
+		unsigned long encodefailed; // packets buildnext() couldn't encode, which sendnext() skipped
+		unsigned long queuedepth[SENDQUEUELEN + 1]; // queuedepth[n]: packets that found n others still waiting to be sent
+	};
+
+	// The sender as a pipeline of three stages, so scanning the next frame overlaps computing and sending this one:
+	//   acquire + kinetics   one AcquisitionWorker per sensor, newest frame handed on through a TripleBuffer
+	//   encode               sendnext() on the caller's thread, packs every sensor's newest kinetics into one packet
+	//   transmit             a thread of its own, publishes the packets from a bounded SpscQueue in order to every subscriber
+	// Everything it needs is allocated by the constructor, so in steady state nothing touches the heap (benchTactilus checks this).
+	class Sender
+	{
+	public:
+		Sender(const std::vector<TactilusUDP*>& sensors, const std::vector<KineticsRequest>& reqs, uint32_t fields);
+		//  sensors[0] publishes the packets to its subscribers, each packet carries the fields (PacketField bits) of every sensor in this order, at most MAXSENSORS
+		//  reqs[i] is what sensors[i] is asked for (reference points, pads). The kinetics kernel is specialised to fields once, here
+		//  The sensors aren't owned and have to outlive the Sender, while it exists their update() records into gettiming()
+
+		Sender(const std::vector<TactilusUDP*>& sensors, const KineticsRequest& req, uint32_t fields);
+		//  Same, asking every sensor for req
+
+		~Sender();
+		//  Stops the workers and the transmit thread
+
+		void setrate(double hz);
+		//  Sends at most hz packets a second, 0 (the default) for as fast as the sensors scan. Call before start()
+
+		void setmap(bool on, unsigned int keyinterval, float floorkPa);
+		//  Whether packets carry every sensor's averaged pressure map too (TactilusMap.h), delta encoded with a keyframe
+		//  every keyinterval packets (1 for only keyframes). Pads below floorkPa and pads sensors[0] gives no area go out as 0
+		//  Off by default. Call before start()
+
+		void start();
+		//  Starts acquiring on every sensor and the transmit thread
+
+		void stop();
+		//  Sends what is still queued, then stops the transmit thread and the workers
+
+		int buildnext();
+		//  Waits until every sensor has a frame that hasn't been encoded yet and encodes the next packet, returns its length
+		//  or -1 if it doesn't fit in a packet (the sequence number is used up all the same, so receivers count it as lost)
+		//  With a rate set, waits for the packet's turn first
+
+		void sendnext();
+		//  buildnext(), then queues the packet for the transmit thread (waiting if SENDQUEUELEN packets are already queued)
+		//  A packet buildnext() couldn't encode is counted in encodefailed and not queued
+
+		const unsigned char* getpacket();
+		//  The packet from the last buildnext()
+
+		SenderStats getstats();
+		//  Stage counters so far, can be called from any thread
+
+		StageTimes& gettiming();
+		//  How long each stage took for every frame and packet since the last reset(), can be read and reset from any thread
+
+	private:
+		void transmit();
+
+		// One slot of the transmit queue
+		struct QueuedPacket
+		{
+			unsigned char data[MAXMAPPACKETLEN];
+			int len;
+			unsigned long long scantimeus; // of the oldest frame in the packet
+		};
+
+		std::vector<TactilusUDP*> sensors;
+		std::vector<AcquisitionWorker*> workers;
+		std::vector<unsigned long> lastframe; // number of the last frame of each worker that was encoded
+		std::vector<const SensorFrame*> frames; // the frame of each worker buildnext() is encoding
+		std::vector<KineticsRequest> reqs; // reqs[i] is read by worker i, never changes after the constructor
+		uint32_t fields;
+		KineticsKernel kernel; // computes just what fields needs
+		std::chrono::steady_clock::duration period; // between packets, 0 for no limit
+		std::chrono::steady_clock::time_point nextsend; // when the next packet may be built
+		float values[MAXSENSORS * MAXFIELDS];
+		unsigned char packet[MAXMAPPACKETLEN];
+		bool mapon; // packets carry the maps too
+		MapEncoder map; // previous maps to take deltas against
+		unsigned long sequence; // sequence number of the next packet
+		unsigned long long scantimeus; // of the oldest frame in packet
+		StageTimes timing;
+
+		SpscQueue<QueuedPacket, SENDQUEUELEN> queue;
+		std::thread transmitter;
+		std::atomic<bool> running;
+		std::atomic<unsigned long> queued; // packets pushed onto queue so far
+		std::atomic<unsigned int> waiters; // 1 while the transmit thread sleeps, so sendnext() only touches the mutex when it has to
+		std::mutex mutex; // only for sleeping on ready
+		std::condition_variable ready;
+
+		std::atomic<unsigned long> sent;
+		std::atomic<unsigned long> skippedframes;
+		std::atomic<unsigned long> queuefull;
+		std::atomic<unsigned long> encodefailed;
+		std::atomic<unsigned long> queuedepth[SENDQUEUELEN + 1];
+	};
+};
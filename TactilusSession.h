@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cctype>
+#include <cstring>
+
+// The control messages sender and receiver exchange, next to the packets, to find each other again after either restarts:
+//   sender -> receiver   "handshake", every HANDSHAKERETRYMS until the receiver answers with its "x,y,N[,key=value...]" reply
+//   receiver -> sender   "heartbeat", every heartbeat=ms of the reply while packets arrive. A sender that was asked for
+//                        heartbeats stops streaming after HEARTBEATMISSES of them didn't come, and handshakes again
+//   receiver -> sender   "rehandshake", when packets arrive before any handshake (the receiver restarted), at most every
+//                        HANDSHAKERETRYMS. The sender stops streaming and handshakes again
+// A reply arriving while streaming replaces what was asked for, unless it is the same reply again.
+// Messages are plain text without a terminating 0, like the reply always was.
+
+#define HANDSHAKEMSG "handshake"
+#define HEARTBEATMSG "heartbeat"
+#define REHANDSHAKEMSG "rehandshake"
+#define HANDSHAKERETRYMS 500 // between handshakes, and between rehandshakes for the same stream
+#define HEARTBEATMS 200 // what TactilusUDP_L asks for
+#define HEARTBEATMISSES 5 // heartbeats in a row a sender waits for before it gives up on the receiver
+#define STREAMTIMEOUTMS 1000 // without packets for this long the receiver counts the sender as gone
+
+namespace tactilus_udp {
+	enum SessionState
+	{
+		SESSION_HANDSHAKING, // sender: waiting for a reply to its handshake, receiver: waiting for a handshake
+		SESSION_STREAMING // packets are flowing
+	};
+
+	inline const char* sessionStateName(SessionState state)
+	{
+		return state == SESSION_STREAMING ? "streaming" : "handshaking";
+	}
+
+	inline bool isControl(const char* msg, int len, const char* control)
+		//  Whether the len bytes of msg are exactly the control message control
+	{
+		return len == (int)strlen(control) && memcmp(msg, control, len) == 0;
+	}
+
+	inline bool isHandshakeReply(const char* msg, int len)
+		//  Whether msg looks like a receiver's reply, which starts with the x of its reference point
+	{
+		return len > 0 && (isdigit((unsigned char)msg[0]) || msg[0] == '-' || msg[0] == '+' || msg[0] == '.');
+	}
+};
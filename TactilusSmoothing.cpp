@@ -0,0 +1,294 @@
+#include "TactilusSmoothing.h"
+
+#include <cstring>
+
+#if !defined(TACTILUS_SMOOTHING_SCALAR)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SMOOTHING_SSE2
+#include <emmintrin.h>
+#endif
+#if (defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))) || defined(_M_X64) || defined(_M_IX86)
+#define SMOOTHING_AVX
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_AVX
+#else
+#define TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SMOOTHING_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace tactilus_udp
+{
+	namespace
+	{
+		// Per pad renormalisation and psi to kPa conversion: 4/3 for each edge the pad sits on, so 16/9 in corners
+		struct SmoothingNorm
+		{
+			float norm[NUMPADS];
+			SmoothingNorm()
+			{
+				for (unsigned int r = 0; r < PADROWS; ++r)
+				{
+					for (unsigned int c = 0; c < PADCOLS; ++c)
+					{
+						float rownorm = (r == 0 || r == PADROWS - 1) ? 4.0f / 3 : 1.0f;
+						float colnorm = (c == 0 || c == PADCOLS - 1) ? 4.0f / 3 : 1.0f;
+						norm[r * PADCOLS + c] = rownorm * colnorm * PSITOKPA;
+					}
+				}
+			}
+		};
+
+		const SmoothingNorm smoothingnorm;
+
+		// Copies a frame into rows with a zero pad on both sides, so every pad has a left and right neighbour
+		void padFrame(const float* psi, float padded[PADROWS][PADCOLS + 2])
+		{
+			for (unsigned int r = 0; r < PADROWS; ++r, psi += PADCOLS)
+			{
+				padded[r][0] = 0;
+				memcpy(&padded[r][1], psi, PADCOLS * sizeof(float));
+				padded[r][PADCOLS + 1] = 0;
+			}
+		}
+
+#if defined(SMOOTHING_SSE2)
+		void smoothFrameSSE2(const float* psi, float* kPa)
+		{
+			float padded[PADROWS][PADCOLS + 2];
+			float h[PADROWS + 2][PADCOLS]; // rows smoothed along columns, with a zero row above and below
+			padFrame(psi, padded);
+			memset(h[0], 0, sizeof(h[0]));
+			memset(h[PADROWS + 1], 0, sizeof(h[0]));
+
+			const __m128 quarter = _mm_set1_ps(0.25f);
+			const __m128 half = _mm_set1_ps(0.5f);
+			for (unsigned int r = 0; r < PADROWS; ++r)
+			{
+				for (unsigned int c = 0; c < PADCOLS; c += 4)
+				{
+					__m128 left = _mm_loadu_ps(&padded[r][c]);
+					__m128 mid = _mm_loadu_ps(&padded[r][c + 1]);
+					__m128 right = _mm_loadu_ps(&padded[r][c + 2]);
+					_mm_storeu_ps(&h[r + 1][c], _mm_add_ps(_mm_mul_ps(quarter, _mm_add_ps(left, right)), _mm_mul_ps(half, mid)));
+				}
+			}
+			for (unsigned int r = 0; r < PADROWS; ++r)
+			{
+				for (unsigned int c = 0; c < PADCOLS; c += 4)
+				{
+					__m128 up = _mm_loadu_ps(&h[r][c]);
+					__m128 mid = _mm_loadu_ps(&h[r + 1][c]);
+					__m128 down = _mm_loadu_ps(&h[r + 2][c]);
+					__m128 v = _mm_add_ps(_mm_mul_ps(quarter, _mm_add_ps(up, down)), _mm_mul_ps(half, mid));
+					_mm_storeu_ps(&kPa[r * PADCOLS + c], _mm_mul_ps(v, _mm_loadu_ps(&smoothingnorm.norm[r * PADCOLS + c])));
+				}
+			}
+		}
+#endif
+
+#if defined(SMOOTHING_AVX)
+		// A row of 8 pads is exactly one AVX register
+		TARGET_AVX void smoothFrameAVX(const float* psi, float* kPa)
+		{
+			float padded[PADROWS][PADCOLS + 2];
+			padFrame(psi, padded);
+
+			const __m256 quarter = _mm256_set1_ps(0.25f);
+			const __m256 half = _mm256_set1_ps(0.5f);
+			__m256 up = _mm256_setzero_ps();
+			__m256 mid = _mm256_add_ps(_mm256_mul_ps(quarter, _mm256_add_ps(_mm256_loadu_ps(&padded[0][0]), _mm256_loadu_ps(&padded[0][2]))), _mm256_mul_ps(half, _mm256_loadu_ps(&padded[0][1])));
+			for (unsigned int r = 0; r < PADROWS; ++r)
+			{
+				__m256 down = _mm256_setzero_ps();
+				if (r + 1 < PADROWS) {
+					down = _mm256_add_ps(_mm256_mul_ps(quarter, _mm256_add_ps(_mm256_loadu_ps(&padded[r + 1][0]), _mm256_loadu_ps(&padded[r + 1][2]))), _mm256_mul_ps(half, _mm256_loadu_ps(&padded[r + 1][1])));
+				}
+				__m256 v = _mm256_add_ps(_mm256_mul_ps(quarter, _mm256_add_ps(up, down)), _mm256_mul_ps(half, mid));
+				_mm256_storeu_ps(&kPa[r * PADCOLS], _mm256_mul_ps(v, _mm256_loadu_ps(&smoothingnorm.norm[r * PADCOLS])));
+				up = mid;
+				mid = down;
+			}
+		}
+
+#if defined(_MSC_VER)
+		bool cpuHasAVX()
+		{
+			int info[4];
+			__cpuid(info, 1);
+			bool osxsave = (info[2] & (1 << 27)) != 0;
+			bool avx = (info[2] & (1 << 28)) != 0;
+			return osxsave && avx && (_xgetbv(0) & 6) == 6; // the OS also has to save the ymm registers
+		}
+#else
+		bool cpuHasAVX()
+		{
+			return __builtin_cpu_supports("avx");
+		}
+#endif
+#endif
+
+#if defined(SMOOTHING_NEON)
+		void smoothFrameNEON(const float* psi, float* kPa)
+		{
+			float padded[PADROWS][PADCOLS + 2];
+			float h[PADROWS + 2][PADCOLS]; // rows smoothed along columns, with a zero row above and below
+			padFrame(psi, padded);
+			memset(h[0], 0, sizeof(h[0]));
+			memset(h[PADROWS + 1], 0, sizeof(h[0]));
+
+			const float32x4_t quarter = vdupq_n_f32(0.25f);
+			const float32x4_t half = vdupq_n_f32(0.5f);
+			for (unsigned int r = 0; r < PADROWS; ++r)
+			{
+				for (unsigned int c = 0; c < PADCOLS; c += 4)
+				{
+					float32x4_t left = vld1q_f32(&padded[r][c]);
+					float32x4_t mid = vld1q_f32(&padded[r][c + 1]);
+					float32x4_t right = vld1q_f32(&padded[r][c + 2]);
+					vst1q_f32(&h[r + 1][c], vmlaq_f32(vmulq_f32(half, mid), quarter, vaddq_f32(left, right)));
+				}
+			}
+			for (unsigned int r = 0; r < PADROWS; ++r)
+			{
+				for (unsigned int c = 0; c < PADCOLS; c += 4)
+				{
+					float32x4_t up = vld1q_f32(&h[r][c]);
+					float32x4_t mid = vld1q_f32(&h[r + 1][c]);
+					float32x4_t down = vld1q_f32(&h[r + 2][c]);
+					float32x4_t v = vmlaq_f32(vmulq_f32(half, mid), quarter, vaddq_f32(up, down));
+					vst1q_f32(&kPa[r * PADCOLS + c], vmulq_f32(v, vld1q_f32(&smoothingnorm.norm[r * PADCOLS + c])));
+				}
+			}
+		}
+#endif
+
+		struct SmoothingDispatch
+		{
+			SmoothingKernel kernel;
+			const char* name;
+			SmoothingDispatch() : kernel(smoothFrameScalar), name("scalar")
+			{
+#if defined(SMOOTHING_NEON)
+				kernel = smoothFrameNEON;
+				name = "neon";
+#endif
+#if defined(SMOOTHING_SSE2)
+				kernel = smoothFrameSSE2;
+				name = "sse2";
+#endif
+#if defined(SMOOTHING_AVX)
+				if (cpuHasAVX()) {
+					kernel = smoothFrameAVX;
+					name = "avx";
+				}
+#endif
+			}
+		};
+
+		const SmoothingDispatch& smoothingDispatch()
+		{
+			static const SmoothingDispatch dispatch; // picked once, the first time a frame is smoothed
+			return dispatch;
+		}
+	}
+
+	void smoothFrame(const float* psi, float* kPa)
+	{
+		smoothingDispatch().kernel(psi, kPa);
+	}
+
+	const char* smoothingBackend()
+	{
+		return smoothingDispatch().name;
+	}
+
+	void smoothFrameScalar(const float* psi, float* kPa)
+	{
+		float padded[PADROWS][PADCOLS + 2];
+		float h[PADROWS + 2][PADCOLS]; // rows smoothed along columns, with a zero row above and below
+		padFrame(psi, padded);
+		memset(h[0], 0, sizeof(h[0]));
+		memset(h[PADROWS + 1], 0, sizeof(h[0]));
+
+		for (unsigned int r = 0; r < PADROWS; ++r)
+		{
+			for (unsigned int c = 0; c < PADCOLS; ++c)
+			{
+				h[r + 1][c] = 0.25f * (padded[r][c] + padded[r][c + 2]) + 0.5f * padded[r][c + 1];
+			}
+		}
+		for (unsigned int r = 0; r < PADROWS; ++r)
+		{
+			for (unsigned int c = 0; c < PADCOLS; ++c)
+			{
+				kPa[r * PADCOLS + c] = (0.25f * (h[r][c] + h[r + 2][c]) + 0.5f * h[r + 1][c]) * smoothingnorm.norm[r * PADCOLS + c];
+			}
+		}
+	}
+
+	unsigned int smoothingKernels(const char** names, SmoothingKernel* kernels, unsigned int max)
+	{
+		unsigned int n = 0;
+		if (n < max) { names[n] = "reference"; kernels[n++] = smoothFrameReference; }
+		if (n < max) { names[n] = "scalar"; kernels[n++] = smoothFrameScalar; }
+#if defined(SMOOTHING_SSE2)
+		if (n < max) { names[n] = "sse2"; kernels[n++] = smoothFrameSSE2; }
+#endif
+#if defined(SMOOTHING_AVX)
+		if (n < max && cpuHasAVX()) { names[n] = "avx"; kernels[n++] = smoothFrameAVX; }
+#endif
+#if defined(SMOOTHING_NEON)
+		if (n < max) { names[n] = "neon"; kernels[n++] = smoothFrameNEON; }
+#endif
+		return n;
+	}
+
+	void smoothFrameReference(const float* psi, float* kPa)
+	{
+		const float* value = psi;
+		for (unsigned int i = 0; i < 128; ++i, ++value) // Gaussian smoothing implementation
+		{
+
+			if (i == 0) {
+				kPa[i] = ((*value * (1.0f / 4) + *(value + 1) * (1.0f / 8) + *(value + 8) * (1.0f / 8) + *(value + 9) * (1.0f / 16)) * 6.8947572932f) * 16.0f / 9; // top left corner case
+			}
+			else if (i == 7) {
+				kPa[i] = ((*value * (1.0f / 4) + *(value - 1) * (1.0f / 8) + *(value + 8) * (1.0f / 8) + *(value + 7) * (1.0f / 16)) * 6.8947572932f) * 16.0f / 9; // top right corner case
+			}
+			else if (i == 120) {
+				kPa[i] = ((*value * (1.0f / 4) + *(value + 1) * (1.0f / 8) + *(value - 8) * (1.0f / 8) + *(value - 7) * (1.0f / 16)) * 6.8947572932f) * 16.0f / 9; // bottom left corner case
+			}
+			else if (i == 127) {
+				kPa[i] = ((*value * (1.0f / 4) + *(value - 1) * (1.0f / 8) + *(value - 8) * (1.0f / 8) + *(value - 9) * (1.0f / 16)) * 6.8947572932f) * 16.0f / 9; // bottom right corner case
+			}
+			else if (i < 8) {
+				kPa[i] = ((*value * (1.0f / 4) + *(value - 1) * (1.0f / 8) + *(value + 1) * (1.0f / 8) + *(value + 8) * (1.0f / 8) +
+					*(value + 7) * (1.0f / 16) + *(value + 9) * (1.0f / 16)) * 6.8947572932f) * 4.0f / 3; // top wall sans corners
+			}
+			else if (i % 8 == 0) {
+				kPa[i] = ((*value * (1.0f / 4) + *(value + 1) * (1.0f / 8) + *(value - 8) * (1.0f / 8) + *(value + 8) * (1.0f / 8) +
+					*(value + 9) * (1.0f / 16) + *(value - 7) * (1.0f / 16)) * 6.8947572932f) * 4.0f / 3; // left wall sans corners
+			}
+			else if (i % 8 == 7) {
+				kPa[i] = ((*value * (1.0f / 4) + *(value - 1) * (1.0f / 8) + *(value - 8) * (1.0f / 8) + *(value + 8) * (1.0f / 8) +
+					*(value - 9) * (1.0f / 16) + *(value + 7) * (1.0f / 16)) * 6.8947572932f) * 4.0f / 3; // right wall sans corners
+			}
+			else if (i > 119) {
+				kPa[i] = ((*value * (1.0f / 4) + *(value - 1) * (1.0f / 8) + *(value + 1) * (1.0f / 8) + *(value - 8) * (1.0f / 8) +
+					*(value - 7) * (1.0f / 16) + *(value - 9) * (1.0f / 16)) * 6.8947572932f) * 4.0f / 3; // bottom wall sans corners
+			}
+			else {
+				kPa[i] = ((*value * (1.0f / 4) + *(value - 1) * (1.0f / 8) + *(value + 1) * (1.0f / 8) + *(value - 8) * (1.0f / 8) + *(value + 8) * (1.0f / 8) +
+					*(value - 7) * (1.0f / 16) + *(value - 9) * (1.0f / 16) + *(value + 7) * (1.0f / 16) + *(value + 9) * (1.0f / 16)) * 6.8947572932f); // middle pads
+			}
+			// 6.8947572932 is the conversion factor, 1 psi = 6.8947572932 kPa
+		}
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "TactilusKinetics.h"
+
+#define PSITOKPA 6.8947572932f // 1 psi = 6.8947572932 kPa
+
+// Build with TACTILUS_SMOOTHING_SCALAR defined to leave out the SSE2/AVX/NEON kernels
+
+namespace tactilus_udp {
+	void smoothFrame(const float* psi, float* kPa);
+	//  3x3 Gaussian smoothing of a 16x8 frame of raw pressures [psi] into kPa, runs the fastest kernel this CPU supports
+	//  Pads on walls and corners are renormalised by the weights that fell off the edge (4/3 and 16/9)
+
+	void smoothFrameReference(const float* psi, float* kPa);
+	//  The original per-pad kernel with a branch for every corner and wall case, kept to compare against
+
+	void smoothFrameScalar(const float* psi, float* kPa);
+	//  Branch-free separable kernel ([1/4 1/2 1/4] along rows then along columns) without SIMD
+
+	const char* smoothingBackend();
+	//  Name of the kernel smoothFrame dispatches to: "avx", "sse2", "neon" or "scalar"
+
+	typedef void (*SmoothingKernel)(const float* psi, float* kPa);
+
+	unsigned int smoothingKernels(const char** names, SmoothingKernel* kernels, unsigned int max);
+	//  Fills in every kernel this build and CPU can run, returns how many, used by the benchmark
+};
@@ -0,0 +1,153 @@
+#include "TactilusSource.h"
+
+#include <cmath>
+#include <thread>
+
+#define PI 3.14159265358979
+#define NOISELEN 8191 // noise values kept, prime so the offsets of consecutive frames don't line up
+
+namespace tactilus_udp
+{
+	namespace
+	{
+		// Bump of pressure around (row, col) with radii rr, rc in pads
+		float blob(unsigned int r, unsigned int c, double row, double col, double rr, double rc)
+		{
+			double dr = (r - row) / rr;
+			double dc = (c - col) / rc;
+			return (float)std::exp(-(dr * dr + dc * dc));
+		}
+
+		double clamp01(double x)
+		{
+			return x < 0 ? 0 : (x > 1 ? 1 : x);
+		}
+	}
+
+	SyntheticGaitSource::SyntheticGaitSource(const GaitParams& gait)
+		: gait(gait), noiseoffset(0), frames(0), noisestate(gait.seed * 0x9E3779B97F4A7C15ull + 1)
+	{
+		for (unsigned int i = 0; i < NUMPADS; ++i)
+		{
+			this->psi[i] = 0;
+		}
+
+		this->stridelength = (unsigned long)(gait.stridetime * gait.scanrate + 0.5);
+		if (this->stridelength == 0) {
+			this->stridelength = 1;
+		}
+		this->stride.resize(this->stridelength * NUMPADS);
+		for (unsigned long n = 0; n < this->stridelength; ++n)
+		{
+			this->generate(n / gait.scanrate, &this->stride[n * NUMPADS]);
+		}
+
+		// NUMPADS extra at the end so a frame never has to wrap around
+		this->noise.resize(NOISELEN + NUMPADS);
+		for (unsigned int i = 0; i < NOISELEN; ++i)
+		{
+			this->noise[i] = (float)gait.noisepsi * this->gaussian();
+		}
+		for (unsigned int i = 0; i < NUMPADS; ++i)
+		{
+			this->noise[NOISELEN + i] = this->noise[i];
+		}
+	}
+
+	void SyntheticGaitSource::scan()
+	{
+		if (this->gait.realtime)
+		{
+			if (this->frames == 0) {
+				this->start = std::chrono::steady_clock::now();
+			}
+			std::chrono::duration<double> due(this->frames / this->gait.scanrate);
+			std::this_thread::sleep_until(this->start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(due));
+		}
+		const float* clean = &this->stride[(this->frames % this->stridelength) * NUMPADS];
+		const float* noise = &this->noise[this->noiseoffset];
+		for (unsigned int i = 0; i < NUMPADS; ++i)
+		{
+			float p = clean[i] + noise[i];
+			this->psi[i] = p > 0 ? p : 0; // the sensor never reads below zero
+		}
+		this->noiseoffset = (this->noiseoffset + 2 * NUMPADS + 1) % NOISELEN;
+		++this->frames;
+	}
+
+	const float* SyntheticGaitSource::matrix()
+	{
+		return this->psi;
+	}
+
+	unsigned int SyntheticGaitSource::rowCount()
+	{
+		return PADROWS;
+	}
+
+	unsigned int SyntheticGaitSource::columnCount()
+	{
+		return PADCOLS;
+	}
+
+	double SyntheticGaitSource::scanRate()
+	{
+		return this->gait.scanrate;
+	}
+
+	unsigned long SyntheticGaitSource::framenumber()
+	{
+		return this->frames;
+	}
+
+	void SyntheticGaitSource::generate(double t, float* psi)
+	{
+		// Where in the stride this foot is, and how far through stance (0 heel strike, 1 toe off)
+		double stride = t / this->gait.stridetime - this->gait.phase;
+		stride = stride - std::floor(stride);
+		double s = stride / this->gait.stance;
+
+		float load = 0;
+		double heel = 0, forefoot = 0, toes = 0;
+		if (s < 1)
+		{
+			// Walking's double humped vertical force: peaks at loading response and push off, dip in mid stance
+			load = (float)(this->gait.peakpsi * 1.3 * std::sin(PI * s) * (0.7 - 0.3 * std::cos(4 * PI * s)));
+			heel = 1 - clamp01((s - 0.45) / 0.25); // heel carries the load until heel off
+			forefoot = clamp01(s / 0.2); // forefoot comes down by foot flat
+			toes = clamp01((s - 0.55) / 0.3); // toes only push at the end
+			double sum = heel + forefoot + toes;
+			heel = heel / sum;
+			forefoot = forefoot / sum;
+			toes = toes / sum;
+		}
+
+		// Rows go from toe (0) to heel (15), columns from outside (0) to inside (7), see the areas map in TactilusUDP.h
+		for (unsigned int r = 0; r < PADROWS; ++r)
+		{
+			for (unsigned int c = 0; c < PADCOLS; ++c)
+			{
+				float p = 0;
+				if (load > 0)
+				{
+					p = load * (float)(heel * blob(r, c, 13.5, 2.5, 2.0, 1.8)
+						+ forefoot * (blob(r, c, 4.5, 3.5, 1.8, 2.5) + 0.3f * blob(r, c, 8.5, 1.5, 2.5, 1.2)) // ball of the foot and the lateral midfoot
+						+ toes * blob(r, c, 1.0, 4.5, 1.2, 1.5));
+				}
+				psi[r * PADCOLS + c] = p;
+			}
+		}
+	}
+
+	float SyntheticGaitSource::gaussian()
+		//  Box-Muller on a 64 bit LCG, so the noise doesn't depend on the standard library
+	{
+		double u[2];
+		for (unsigned int i = 0; i < 2; ++i)
+		{
+			this->noisestate = this->noisestate * 6364136223846793005ull + 1442695040888963407ull;
+			u[i] = ((this->noisestate >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+		}
+		return (float)(std::sqrt(-2 * std::log(u[0])) * std::cos(2 * PI * u[1]));
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "TactilusKinetics.h"
+
+#ifdef _WIN32
+#include "tactilus.h"
+#endif
+
+namespace tactilus_udp {
+	// Where TactilusUDP gets its raw pressure frames from, shaped like the vendor Tactilus class
+	class FrameSource
+	{
+	public:
+		virtual ~FrameSource() {}
+
+		virtual void scan() = 0;
+		//  Blocks until the next frame is available, like Tactilus::scan()
+
+		virtual const float* matrix() = 0;
+		//  The frame from the last scan(), rowCount()*columnCount() pressures in psi, row by row
+
+		virtual unsigned int rowCount() = 0;
+		virtual unsigned int columnCount() = 0;
+
+		virtual double scanRate() { return 0; }
+		//  Frames per second scan() delivers, 0 if the source can't tell (the vendor SDK doesn't say)
+	};
+
+#ifdef _WIN32
+	// The insole itself, through the vendor SDK
+	class TactilusSdkSource : public FrameSource
+	{
+	public:
+		TactilusSdkSource()
+			//  Connects to the next insole the driver has registered
+		{
+			this->t = new Tactilus();
+			printf("Connecting to Tactilus...");
+			this->t->connect(true); //do this first so that the next t->connect(true); doesn't take seconds to happen
+			printf("Connected.\n");
+		}
+
+		~TactilusSdkSource() { delete this->t; }
+
+		void scan() { this->t->scan(); }
+		const float* matrix() { return this->t->matrix(); }
+		unsigned int rowCount() { return this->t->rowCount(); }
+		unsigned int columnCount() { return this->t->columnCount(); }
+
+		Tactilus* gettactilusid() { return this->t; }
+
+	private:
+		Tactilus* t;
+	};
+#endif
+
+	// How SyntheticGaitSource walks
+	struct GaitParams
+	{
+		double scanrate = 250; // frames per second
+		double stridetime = 1.1; // seconds from one heel strike to the next of the same foot
+		double stance = 0.6; // fraction of the stride the foot is on the ground
+		double phase = 0; // fraction of a stride this foot lags behind, 0.5 for the other foot
+		double peakpsi = 40; // pressure under the heel at heel strike and under the forefoot at toe off
+		double noisepsi = 0.3; // standard deviation of the noise on every pad, also present in swing
+		unsigned int seed = 1; // same seed, same frames
+		bool realtime = true; // scan() waits for the next frame time like the insole does, false returns straight away
+	};
+
+	// Deterministic stand-in for an insole: a pressure patch rolling from heel strike to toe off with the
+	// double humped loading of walking, a swing phase with only noise, and Gaussian noise on every pad.
+	// Frame n always shows time n/scanrate, so a run is repeatable whatever the machine does.
+	// One stride and a block of noise are generated up front so scan() costs about as little as copying a frame.
+	class SyntheticGaitSource : public FrameSource
+	{
+	public:
+		SyntheticGaitSource(const GaitParams& gait);
+
+		void scan();
+		const float* matrix();
+		unsigned int rowCount();
+		unsigned int columnCount();
+		double scanRate();
+
+		unsigned long framenumber();
+		//  Number of scans done so far
+
+		void generate(double t, float* psi);
+		//  The noise free frame at t seconds into the walk
+
+	private:
+		float gaussian();
+
+		GaitParams gait;
+		float psi[NUMPADS];
+		std::vector<float> stride; // noise free frames of one stride, one after the other
+		unsigned long stridelength; // frames in a stride
+		std::vector<float> noise; // noisepsi scaled Gaussian noise, read at a different offset every frame
+		unsigned long noiseoffset;
+		unsigned long frames;
+		unsigned long long noisestate;
+		std::chrono::steady_clock::time_point start;
+	};
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#include "TactilusHistogram.h"
+
+// Where the time of every frame goes on its way from the insole to the wire. Each stage has a Histogram
+// of how long it took in ns, recording is a clock read and a few relaxed atomic adds, so it is always on.
+
+namespace tactilus_udp {
+	enum Stage
+	{
+		STAGE_SCAN, // FrameSource::scan(), for the insoles the vendor SDK waiting for and reading a frame
+		STAGE_SMOOTH, // spatial smoothing of the scan
+		STAGE_FILTER, // temporal filter (averaging) over consecutive frames
+		STAGE_KINETICS, // estimateKinetics() on the filtered frame
+		STAGE_ENCODE, // packing every sensor's kinetics into one packet
+		STAGE_SEND, // sendto()
+		STAGE_AGE, // from the end of the oldest scan in a packet to sendto() returning
+		NUMSTAGES
+	};
+
+	inline const char* stageName(Stage stage)
+	{
+		static const char* names[NUMSTAGES] = { "scan", "smooth", "filter", "kinetics", "encode", "send", "age" };
+		return names[stage];
+	}
+
+	inline uint64_t elapsedns(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+	{
+		return to > from ? (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count() : 0;
+	}
+
+	// One Histogram per Stage, shared by every thread of a pipeline
+	class StageTimes
+	{
+	public:
+		void record(Stage stage, uint64_t ns) { this->hist[stage].record(ns); }
+
+		void record(Stage stage, std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+		{
+			this->hist[stage].record(elapsedns(from, to));
+		}
+
+		Histogram& get(Stage stage) { return this->hist[stage]; }
+
+		void reset()
+		{
+			for (unsigned int i = 0; i < NUMSTAGES; ++i)
+			{
+				this->hist[i].reset();
+			}
+		}
+
+		int format(char* text, unsigned int len)
+			//  One line "stage p50/p99/max us: scan 3912/4120/5011 smooth ..." into text, snprintf's return value
+			//  Doesn't allocate, so it can run next to the pipeline
+		{
+			int used = snprintf(text, len, "stage p50/p99/max us:");
+			for (unsigned int i = 0; i < NUMSTAGES && used >= 0 && (unsigned int)used < len; ++i)
+			{
+				const Histogram& h = this->hist[i];
+				int n = snprintf(text + used, len - used, " %s %.1f/%.1f/%.1f", stageName((Stage)i),
+					h.percentile(50) / 1000.0, h.percentile(99) / 1000.0, h.max() / 1000.0);
+				used = n < 0 ? n : used + n;
+			}
+			return used;
+		}
+
+	private:
+		Histogram hist[NUMSTAGES];
+	};
+};
@@ -0,0 +1,506 @@
+#define _WINSOCK_DEPRECATED_NO_WARNINGS
+
+#include "TactilusUDP.h"
+
+#include <cstring>
+
+#include "TactilusSmoothing.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/select.h>
+#include <unistd.h>
+
+// The Winsock names this file uses, for BSD sockets
+#define SOCKET_ERROR -1
+#define INVALID_SOCKET -1
+#define WSAEWOULDBLOCK EAGAIN
+#define WSAECONNRESET ECONNREFUSED // what an ICMP port unreachable turns into on a UDP socket
+#define closesocket close
+static int WSAGetLastError() { return errno; }
+#endif
+
+namespace tactilus_udp
+{
+#ifdef _WIN32
+	TactilusUDP::TactilusUDP(const char* dest_address, u_int src_port, u_int dest_port)
+		//	Initialize everything as needed, for the communicator sensor
+		: TactilusUDP(dest_address, src_port, dest_port, 1)
+	{
+	}
+
+	TactilusUDP::TactilusUDP(const char* dest_address, u_int src_port, u_int dest_port, u_int communicator)
+		//	Initialize everything as needed, frames come from the next insole the Tactilus driver has registered
+		: TactilusUDP(new TactilusSdkSource(), dest_address, src_port, dest_port, communicator)
+	{
+	}
+#endif
+
+	TactilusUDP::TactilusUDP(FrameSource* source, const char* dest_address, u_int src_port, u_int dest_port, u_int communicator)
+		//	Initialize everything as needed, frames come from source
+		/*	FrameSource* source			where the raw frames come from, deleted with this object
+		//	char* dest_address			IPv4 address destination written as a string
+		//	u_int src_port				local port that we are sending from (irrelevant if not communicator)
+		//	u_int dest_port				remote port that we are sending to (irrelevant if not communicator)
+		//  u_int communicator          1 if this sensor is the commmunicator (the sensor object sending and receiving messages) and 0 if it is not
+		*/
+	{
+		this->source = source;
+		FilterParams boxcar;
+		boxcar.kind = FILTER_BOXCAR;
+		boxcar.length = FORCEBUFLEN;
+		this->filter = makeFilter(boxcar);
+		this->rows = this->source->rowCount();
+		this->cols = this->source->columnCount();
+
+		// Makes float[][] that characterizes areas of each pad in mm^2
+		double padarea = 13.0 *17.2;
+		for (unsigned int i = 0; i < 16; ++i)
+		{
+			for (unsigned int j = 0; j < 8; ++j)
+			{
+				areas[i][j] = areas[i][j] * padarea;
+			}
+		}
+
+#ifdef _WIN32
+		//Initialize winsock
+		printf("\nInitialising Winsock...");
+		if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+		{
+			printf("Failed. Error Code : %d", WSAGetLastError());
+			exit(EXIT_FAILURE);
+		}
+		printf("Initialised.\n");
+#endif
+
+		//Create a socket
+		if ((s = socket(AF_INET, SOCK_DGRAM, 0)) == INVALID_SOCKET)
+		{
+			printf("Could not create socket : %d", WSAGetLastError());
+		}
+		printf("Socket created...");
+
+		//setup address structure
+		memset((char *)&si_other, 0, sizeof(si_other));
+		si_other.sin_family = AF_INET; // designates that we are using IPv4 addresses
+		si_other.sin_port = htons(dest_port);
+		si_other.sin_addr.s_addr = inet_addr(dest_address);
+
+		subscribers[0].addr = si_other;
+		subscribers[0].period = std::chrono::steady_clock::duration(0);
+		subscribers[0].sent = 0;
+		subscribers[0].failed = 0;
+		nsubscribers = 1;
+
+		memset((char *)&srcaddr, 0, sizeof(srcaddr));
+		srcaddr.sin_family = AF_INET; // designates that we are using IPv4 addresses
+		srcaddr.sin_port = htons(src_port);
+		srcaddr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+		//Bind, tying our socket to the srcaddr information (local IP address, source port)
+		if (bind(s, (struct sockaddr *)&srcaddr, sizeof(srcaddr)) == SOCKET_ERROR && communicator==1)
+		{
+			printf("Bind failed with error code : %d", WSAGetLastError());
+			exit(EXIT_FAILURE);
+		}
+
+		if (communicator == 1)
+		{
+			puts("Bind done...\n");
+			printf("Setting socket to non-blocking...");
+#ifdef _WIN32
+			u_long mode = 1;  // 1 to enable non-blocking socket, this allows recv to time out and not run forever (may not be necessary)
+			ioctlsocket(s, FIONBIO, &mode);
+#else
+			fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+#endif
+			printf("Set.\n");
+		}	
+
+	}
+
+	TactilusUDP::~TactilusUDP()
+		//	Clean up Tactilus class
+	{
+		closesocket(s);
+#ifdef _WIN32
+		WSACleanup();
+#endif
+		delete this->source;
+		delete this->filter;
+	}
+
+	FrameSource* TactilusUDP::getsource()
+	{
+		return this->source;
+	}
+
+	void TactilusUDP::send(std::string message)
+		//	Takes a message and sends it to dest_address with src_port and dest_port as initialized
+	{
+		this->send(message.c_str(), (int)strlen(message.c_str()));
+	}
+
+	void TactilusUDP::send(const char* data, int len)
+		//	Sends len bytes of data to dest_address with src_port and dest_port as initialized
+	{
+		if (sendto(s, data, len, 0, (struct sockaddr *) &si_other, slen) == SOCKET_ERROR)
+		{
+			printf("sendto() failed with error code : %d\n", WSAGetLastError()); // e.g. no route while the link is down, the session retries
+		}
+	}
+
+	void TactilusUDP::send(const char* data, int len, u_int port)
+		//	Sends len bytes of data to port on dest_address, from src_port
+	{
+		struct sockaddr_in dest = si_other;
+		dest.sin_port = htons(port);
+		if (sendto(s, data, len, 0, (struct sockaddr *) &dest, sizeof(dest)) == SOCKET_ERROR)
+		{
+			printf("sendto() failed with error code : %d\n", WSAGetLastError());
+		}
+	}
+
+	int TactilusUDP::recv()
+		//	Checks whether anything is in to be received to our address and src_port
+		//  If there isn't, then just leave after setting buf to an empty string
+	{
+		buf[0] = '\0';
+		socklen_t fromlen = sizeof(from);
+		int len = recvfrom(s, buf, BUFLEN - 1, 0, (struct sockaddr *) &from, &fromlen);
+		if (len == SOCKET_ERROR)
+		{
+			int error = WSAGetLastError();
+			// Nothing there, or the ICMP port unreachable an earlier sendto() got back because nobody listened yet
+			if (error != WSAEWOULDBLOCK && error != WSAECONNRESET) {
+				printf("recvfrom() failed with error code : %d\n", error);
+				return -1;
+			}
+			return 0;
+		}
+		buf[len] = '\0';
+		return len;
+	}
+
+	int TactilusUDP::recv(unsigned int timeoutms)
+		//	Sleeps in select() until something arrives or timeoutms passed, then recv()
+	{
+		fd_set readable;
+		FD_ZERO(&readable);
+		FD_SET(s, &readable);
+		struct timeval timeout;
+		timeout.tv_sec = timeoutms / 1000;
+		timeout.tv_usec = (timeoutms % 1000) * 1000;
+		if (select((int)s + 1, &readable, NULL, NULL, &timeout) <= 0) {
+			buf[0] = '\0';
+			return 0;
+		}
+		return this->recv();
+	}
+
+	bool TactilusUDP::fromdestination()
+	{
+		return from.sin_addr.s_addr == si_other.sin_addr.s_addr && from.sin_port == si_other.sin_port;
+	}
+
+	void TactilusUDP::clearsubscribers()
+	{
+		subscribers[0].sent = 0;
+		subscribers[0].failed = 0;
+		nsubscribers = 1;
+	}
+
+	bool TactilusUDP::addsubscriber(const char* address, u_int port, double hz)
+		//	Adds address:port to the destinations of publish(), multicast groups get a TTL of 1 so the packets stay on this network
+	{
+		unsigned long ip = inet_addr(address);
+		if (nsubscribers >= MAXSUBSCRIBERS || ip == INADDR_NONE)
+		{
+			return false;
+		}
+		Subscriber& sub = subscribers[nsubscribers];
+		memset((char *)&sub.addr, 0, sizeof(sub.addr));
+		sub.addr.sin_family = AF_INET;
+		sub.addr.sin_port = htons(port);
+		sub.addr.sin_addr.s_addr = ip;
+		sub.period = hz > 0 ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / hz)) : std::chrono::steady_clock::duration(0);
+		sub.nextsend = std::chrono::steady_clock::time_point();
+		sub.sent = 0;
+		sub.failed = 0;
+		if ((ntohl(ip) >> 28) == 14) // 224.0.0.0/4
+		{
+			unsigned char ttl = 1;
+			setsockopt(s, IPPROTO_IP, IP_MULTICAST_TTL, (const char*)&ttl, sizeof(ttl));
+		}
+		++nsubscribers;
+		return true;
+	}
+
+	void TactilusUDP::publish(const char* data, int len)
+		//	Sends data to every destination that is due one
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < nsubscribers; ++i)
+		{
+			Subscriber& sub = subscribers[i];
+			if (sub.period.count() > 0) {
+				if (now < sub.nextsend) {
+					continue;
+				}
+				// Keeps to the rate on average, but doesn't make up for a long gap with a burst
+				sub.nextsend = sub.nextsend + sub.period > now ? sub.nextsend + sub.period : now + sub.period;
+			}
+			if (sendto(s, data, len, 0, (struct sockaddr *) &sub.addr, sizeof(sub.addr)) == SOCKET_ERROR)
+			{
+				if (sub.failed == 0) {
+					printf("sendto() to subscriber %u failed with error code : %d\n", i, WSAGetLastError());
+				}
+				sub.failed.store(sub.failed.load() + 1); // only this thread writes them
+				continue;
+			}
+			sub.sent.store(sub.sent.load() + 1);
+		}
+	}
+
+	unsigned int TactilusUDP::getsubscribercount()
+	{
+		return nsubscribers;
+	}
+
+	const Subscriber& TactilusUDP::getsubscriber(unsigned int i)
+	{
+		return subscribers[i];
+	}
+
+	void TactilusUDP::update() {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		this->source->scan();
+		this->scantime = std::chrono::steady_clock::now();
+		const float* value = this->source->matrix();
+		smoothFrame(value, this->smoothed); // Gaussian smoothing, smoothed is therefore in kPa
+		std::chrono::steady_clock::time_point smoothtime = std::chrono::steady_clock::now();
+		this->filter->filter(this->smoothed, this->avgkPa); // over time, the FORCEBUFLEN frame average unless setfilter() chose another
+		if (this->timing != NULL) {
+			std::chrono::steady_clock::time_point filtertime = std::chrono::steady_clock::now();
+			this->timing->record(STAGE_SCAN, start, this->scantime);
+			this->timing->record(STAGE_SMOOTH, this->scantime, smoothtime);
+			this->timing->record(STAGE_FILTER, smoothtime, filtertime);
+		}
+	}
+
+	void TactilusUDP::setfilter(const FilterParams& params)
+		//  Replaces the temporal filter, starting over from the next update()
+	{
+		FilterParams filterparams = params;
+		if (filterparams.rate <= 0) {
+			filterparams.rate = (float)this->source->scanRate(); // still 0 for the insoles, the filter then takes 250 Hz
+		}
+		TemporalFilter* previous = this->filter;
+		this->filter = makeFilter(filterparams);
+		delete previous;
+	}
+
+	const char* TactilusUDP::getfiltername()
+	{
+		return this->filter->name();
+	}
+
+	void TactilusUDP::settiming(StageTimes* timing)
+	{
+		this->timing = timing;
+	}
+
+	unsigned long long TactilusUDP::getscantimeus()
+		//  When the last update() finished scanning, in microseconds on the steady clock
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(this->scantime.time_since_epoch()).count();
+	}
+
+	char* TactilusUDP::getbuf()
+		//	Returns pointer to first index of buffer of message received
+	{
+		return buf;
+	}
+
+	float* TactilusUDP::getpresbuftosend()
+		//  Returns presbuftosend
+	{
+		return presbuftosend;
+	}
+
+	void TactilusUDP::updatepresbuftosend()
+		//  Update presbuftosend
+	{
+		for (unsigned int head = 0; head < this->rows * this->cols; ++head)
+		{
+			presbuftosend[head] = this->avgkPa[head];
+		}
+	}
+
+	std::string TactilusUDP::allpressurepads()
+		//	Return string with all pressure readings in an array in [x,y] = P format; Units of kPa
+	{
+		char msg[BUFLEN];
+		std::string concatstr = "";
+		int head = 0;
+		float avgcurrkPa = 0;
+
+		for (unsigned int r = 0; r < this->rows; ++r)
+		{
+			for (unsigned int c = 0; c < this->cols; ++c, ++head)
+			{
+				avgcurrkPa = this->avgkPa[head]; // filtered over time, kept up to date by update()
+				if (snprintf(msg, sizeof(msg), "[%d,%d] = %f \n", c, r, avgcurrkPa) < 0)
+				{
+					throw ERROR_DS_ENCODING_ERROR;
+				}
+				concatstr.append(msg);
+			}
+		}
+		return concatstr;
+	}
+
+	void TactilusUDP::estimateKinetics(const KineticsRequest& req, KineticsResult& res)
+		//  One sweep over the averaged frame gives force, CoP, moments about (req.x1, req.y1), front/back forces, requested pad forces, contact area and peak pressure
+	{
+		computeKinetics(this->avgkPa, this->areas, req, res);
+	}
+
+	void TactilusUDP::estimateKinetics(const SensorFrame& frame, const KineticsRequest& req, KineticsResult& res)
+		//  Same as above but on a frame taken earlier with getframe()
+	{
+		computeKinetics(frame.kPa, this->areas, req, res);
+	}
+
+	void TactilusUDP::estimateKinetics(const SensorFrame& frame, const KineticsRequest& req, KineticsKernel kernel, KineticsResult& res)
+		//  Same but with a kernel from kineticsKernel()
+	{
+		kernel(frame.kPa, this->areas, req, res);
+	}
+
+	void TactilusUDP::getframe(SensorFrame& frame)
+		//  Copies the averaged frame and its scan time
+	{
+		memcpy(frame.kPa, this->avgkPa, sizeof(frame.kPa));
+		frame.scantimeus = this->getscantimeus();
+	}
+
+	double TactilusUDP::getpadarea(u_int row, u_int col)
+	{
+		return row < PADROWS && col < PADCOLS ? this->areas[row][col] : 0;
+	}
+
+	double TactilusUDP::estimateForce()
+		//  Estimate force by multiplying areas with pressure, in N
+	{
+		KineticsRequest req;
+		KineticsResult res;
+		this->estimateKinetics(req, res);
+		return res.force;
+	}
+
+	void TactilusUDP::estimateCoP(double* p)
+		//  Estimate location of center of pressure, in mm
+		//  x or p[0] should go from back to front of foot.
+		//  y or p[1] should go from inside to outside of foot [will be anti-parallel from left foot to right foot].
+	{
+		KineticsRequest req;
+		KineticsResult res;
+		this->estimateKinetics(req, res);
+		p[0] = res.copx;
+		p[1] = 0;
+		if (res.force != 0) {
+			p[1] = 100 - 9.0 * (res.sumfc / res.force + 0.5); // CoP has always used (c * 9.0 + 9.0/2.0) as the -y center locations of pads
+		}
+	}
+
+	double TactilusUDP::estimateMoment_y(double x1)
+		//  Estimate value of moment at specified location x1: x_max should be 270mm. 
+		//  x should go from back of foot to front of foot
+		//  Returns in Nm
+	{
+		KineticsRequest req;
+		KineticsResult res;
+		req.x1 = x1;
+		this->estimateKinetics(req, res);
+		return res.momenty;
+	}
+
+	void TactilusUDP::estimateForceAndMoment_y(double x1, double* forceandmoment)
+		//  Estimate value of moment at specified location x1: x_max should be 270mm. 
+		//  x should go from back of foot to front of foot
+		//  Returns in N and Nm
+	{
+		KineticsRequest req;
+		KineticsResult res;
+		req.x1 = x1;
+		this->estimateKinetics(req, res);
+		forceandmoment[0] = res.force;
+		forceandmoment[1] = res.momenty;
+	}
+
+	void TactilusUDP::estimateForceAndMoment_yx(double x1, double y1, double* forceandmoment) {
+		//  Estimate force, value about y axis of moment at specified location x1 [x_max should be 270mm], and value about x axis of moment at specified location y1 [y_max should be 100mm]
+		//  x should go from back of foot to front of foot, y should go from inside of foot to outside of foot [will be anti-parallel from left foot to right foot]
+		//  Returns in N and Nm
+		//  NOTE: be careful of the signs of moments! They may not be consistent depending on which foot. Make sure to figure out what the signs of the moments should be further down the algorithm
+
+		KineticsRequest req;
+		KineticsResult res;
+		req.x1 = x1;
+		req.y1 = y1;
+		this->estimateKinetics(req, res);
+		forceandmoment[0] = res.force;
+		forceandmoment[1] = res.momenty;
+		forceandmoment[2] = res.momentx;
+	}
+
+	void TactilusUDP::estimateForceAndMoment_yx_somepadforces(double x1, double y1, u_int* padx, u_int* pady, u_int padnumber, double* forceandmoment) {
+		//  Estimate force, value about y axis of moment at specified location x1 [x_max should be 270mm], and value about x axis of moment at specified location y1 [y_max should be 100mm]
+		//  x should go from back of foot to front of foot, y should go from inside of foot to outside of foot [will be anti-parallel from left foot to right foot]
+		//  Will also return forces from requested pads, given by x coordinates in padx and y coordinates in pady (at most MAXPADREQ pads)
+		//  forceandmoment needs room for 3 + padnumber values, pads past MAXPADREQ are set to 0
+		//  Returns in N and Nm
+		//  NOTE: be careful of the signs of moments! They may not be consistent depending on which foot. Make sure to figure out what the signs of the moments should be further down the algorithm
+
+		KineticsRequest req;
+		KineticsResult res;
+		req.x1 = x1;
+		req.y1 = y1;
+		req.padnumber = padnumber < MAXPADREQ ? padnumber : MAXPADREQ;
+		for (u_int j = 0; j < req.padnumber; ++j)
+		{
+			req.padx[j] = padx[j];
+			req.pady[j] = pady[j];
+		}
+		this->estimateKinetics(req, res);
+		forceandmoment[0] = res.force;
+		forceandmoment[1] = res.momenty;
+		forceandmoment[2] = res.momentx;
+		for (u_int j = 0; j < padnumber; ++j)
+		{
+			forceandmoment[3 + j] = j < res.padnumber ? res.padforces[j] : 0;
+		}
+	}
+
+	void TactilusUDP::estimateForceAndMoment_yx_frontbackforces(double x1, double y1, double* forceandmoment) {
+		//  Estimate force, value about y axis of moment at specified location x1 [x_max should be 270mm], and value about x axis of moment at specified location y1 [y_max should be 100mm]
+		//  x should go from back of foot to front of foot, y should go from inside of foot to outside of foot [will be anti-parallel from left foot to right foot]
+		//  Also returns force of front 64 pads and force of back 64 pads
+		//  Returns in N and Nm
+		//  NOTE: be careful of the signs of moments! They may not be consistent depending on which foot. Make sure to figure out what the signs of the moments should be further down the algorithm
+
+		KineticsRequest req;
+		KineticsResult res;
+		req.x1 = x1;
+		req.y1 = y1;
+		this->estimateKinetics(req, res);
+		forceandmoment[0] = res.force;
+		forceandmoment[1] = res.momenty;
+		forceandmoment[2] = res.momentx;
+		forceandmoment[3] = res.frontforce;
+		forceandmoment[4] = res.backforce;
+	}
+}
@@ -1,22 +1,49 @@
 #pragma once
 
+#include <atomic>
 #include <iostream>
-#include "tactilus.h"
 #include <cstdio>
 #include <string>
 #include <vector>
+#include <chrono>
 
+#ifdef _WIN32
 #include<winsock2.h>
 #include<Ws2tcpip.h>
 
 #pragma comment(lib,"ws2_32.lib") //Winsock Library
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define ERROR_DS_ENCODING_ERROR 8253L // what allpressurepads() throws when formatting fails, same value as in winerror.h
+#endif
+
+#include "TactilusFilter.h"
+#include "TactilusKinetics.h"
+#include "TactilusSource.h"
+#include "TactilusTiming.h"
+#include "TactilusWorker.h"
 
 #define BUFLEN 16000
-#define FORCEBUFLEN 32
+#define FORCEBUFLEN 32 // frames the default boxcar filter averages over
+#define MAXSUBSCRIBERS 8 // destinations publish() fans out to, dest_address included
 
 // Author:	Jehan Yang
 
 namespace tactilus_udp {
+	// One of the destinations publish() sends to
+	struct Subscriber
+	{
+		struct sockaddr_in addr; // unicast address or multicast group, and port
+		std::chrono::steady_clock::duration period; // least time between two packets, 0 for every packet
+		std::chrono::steady_clock::time_point nextsend; // when it may get the next one
+		std::atomic<unsigned long> sent; // packets handed to sendto(), can be read while another thread publishes
+		std::atomic<unsigned long> failed; // sendto() errors
+	};
+
 	// C++ class to process Tautilus data and to send over UDP
 	class TactilusUDP
 	{
@@ -24,6 +51,7 @@ namespace tactilus_udp {
 
 	public:
 
+#ifdef _WIN32
 		//	Initialize everything as needed for sending Tactilus force data over UDP
 		TactilusUDP(const char* dest_address, u_int src_port, u_int dest_port);
 		//	char* dest_address			IPv4 address destination written as a string
@@ -37,21 +65,72 @@ namespace tactilus_udp {
 		//	u_int dest_port				remote port that we are sending to (irrelevant if not communicator)
 		//  u_int communicator          1 if this sensor is the commmunicator (the sensor object sending and receiving messages) and 0 if it is not
 		*/
+#endif
+
+		TactilusUDP(FrameSource* source, const char* dest_address, u_int src_port, u_int dest_port, u_int communicator);
+		//	Same, but frames come from source (e.g. a SyntheticGaitSource when there is no insole), which this object then owns
 
 		~TactilusUDP();
 		//	Clean up Tactilus class, not really sure when needed
 
-		Tactilus* gettactilusid();
-		//  Gets Tactilus id
+		FrameSource* getsource();
+		//  Where the frames come from
 
 		void send(std::string message);
 		//	Takes a message and sends it to dest_address with src_port and dest_port as initialized
+
+		void send(const char* data, int len);
+		//	Sends len bytes of data (e.g. a binary packet from TactilusPacket.h) to dest_address with src_port and dest_port as initialized
+		//	A failure is printed, not fatal
+
+		void send(const char* data, int len, u_int port);
+		//	Same, but to another port of dest_address (e.g. where the receiver listens for the stage timings)
 		
-		void recv();
-		//	Checks whether anything is in to be received to our address and src_port, writes to buf
+		int recv();
+		//	Checks whether anything is in to be received to our address and src_port, writes to buf and returns its length
+		//	0 if nothing is there (or only an ICMP port unreachable from a receiver that isn't listening yet), -1 on other errors
+		//	Where it came from doesn't change where anything is sent
+
+		int recv(unsigned int timeoutms);
+		//	Same, but waits up to timeoutms for something to arrive without spinning
+
+		bool fromdestination();
+		//	Whether the last recv() got its message from dest_address:dest_port, rather than e.g. from a subscriber
+
+		bool addsubscriber(const char* address, u_int port, double hz);
+		//	From now on publish() also sends to address:port, a unicast address or a multicast group, at most hz packets a second (0 for all)
+		//	Returns false if MAXSUBSCRIBERS are already there or address isn't an IPv4 address
+		//	Not thread safe, call it before a Sender starts publishing
+
+		void publish(const char* data, int len);
+		//	Sends the same len bytes of data to dest_address and to every subscriber whose rate limit lets it have them now
+		//	A subscriber that can't be reached is counted in its failed, unlike send() this never exits
+
+		void clearsubscribers();
+		//	Forgets every subscriber addsubscriber() added, e.g. before a new handshake asks for others. Not thread safe either
+
+		unsigned int getsubscribercount();
+		//	Destinations publish() sends to, dest_address included
+
+		const Subscriber& getsubscriber(unsigned int i);
+		//	Destination i, 0 being dest_address
 
 		void update();
-		//  Update the ringbuf with pressure readings
+		//  Scans a frame, smooths it and runs it through the temporal filter
+
+		void setfilter(const FilterParams& params);
+		//  Chooses the temporal filter update() runs (a FORCEBUFLEN frame boxcar average until this is called)
+		//  A rate of 0 in params is taken to be the source's scan rate
+		//  Not thread safe, call it before anything else runs update()
+
+		const char* getfiltername();
+		//  Name of the temporal filter, as in parseFilter()
+
+		void settiming(StageTimes* timing);
+		//  From now on update() records how long scanning, smoothing and filtering took into timing (NULL to stop), which isn't owned
+
+		unsigned long long getscantimeus();
+		//  When the last update() finished scanning, in microseconds on the steady clock (what packets are timestamped with)
 		
 		char* getbuf();
 		//	Returns pointer to first index of buffer of message received
@@ -65,40 +144,65 @@ namespace tactilus_udp {
 		std::string allpressurepads();
 		//	Return string with all pressure readings in an array in [x,y] = P format [kPa]
 
+		void estimateKinetics(const KineticsRequest& req, KineticsResult& res);
+		//  Computes every kinetic quantity in one sweep over the averaged frame, the estimate* functions below are views on this
+		//  None of these keep state, outputs always go to the caller's buffers, so different sensors can be estimated on different threads
+
+		void estimateKinetics(const SensorFrame& frame, const KineticsRequest& req, KineticsResult& res);
+		//  Same but on a frame taken earlier with getframe(), so it is safe while another thread runs update()
+
+		void estimateKinetics(const SensorFrame& frame, const KineticsRequest& req, KineticsKernel kernel, KineticsResult& res);
+		//  Same but only what kernel (from kineticsKernel()) computes, the rest of res is 0
+
+		void getframe(SensorFrame& frame);
+		//  Copies the averaged frame and its scan time, for handing over to another thread
+
+		double getpadarea(u_int row, u_int col);
+		//  Area the kinetics give pad [row][col] in mm^2, 0 for pads that don't count
+
 		double estimateForce();
 		//  Estimate force by multiplying areas with pressure [N]
 
-		double* estimateCoP();
-		//  Estimate location of center of pressure [mm]
+		void estimateCoP(double* p);
+		//  Estimate location of center of pressure [mm] into p[0] (x) and p[1] (y)
 
 		double estimateMoment_y (double x);
 		//  Estimate moment at specified location x1: x_max should be 270 mm [Nm]
 
-		double* estimateForceAndMoment_y(double x);
-		//  Estimates moment and force, will be faster than independently sending both
+		void estimateForceAndMoment_y(double x, double* forceandmoment);
+		//  Estimates force and moment into forceandmoment[0..1], will be faster than independently sending both
 
-		double* estimateForceAndMoment_yx(double x1, double y1);
-		//  Estimates moment about two axes and force in z direction
+		void estimateForceAndMoment_yx(double x1, double y1, double* forceandmoment);
+		//  Estimates force in z direction and moment about two axes into forceandmoment[0..2]
 
-		std::vector<double> estimateForceAndMoment_yx_somepadforces(double x1, double y1, u_int* padx, u_int* pady, u_int padnumber);
-		//  Estimates moment about two axes, total force in z direction, and force from requested pads
+		void estimateForceAndMoment_yx_somepadforces(double x1, double y1, u_int* padx, u_int* pady, u_int padnumber, double* forceandmoment);
+		//  Estimates total force in z direction, moment about two axes, and force from requested pads into forceandmoment[0..2+padnumber]
 
-		std::vector<double> TactilusUDP::estimateForceAndMoment_yx_frontbackforces(double x1, double y1);
-		//  Estimates moment about two axes, total force in z direction, and force of front 64 pads and force of back 64 pads
+		void estimateForceAndMoment_yx_frontbackforces(double x1, double y1, double* forceandmoment);
+		//  Estimates total force in z direction, moment about two axes, force of front 64 pads and force of back 64 pads into forceandmoment[0..4]
 
 
 
 	private:
 		struct sockaddr_in si_other, srcaddr;
-		int s, slen = sizeof(si_other); // s is number of socket that is initialized in constructor
+		int s; // s is number of socket that is initialized in constructor
+		socklen_t slen = sizeof(si_other);
+		struct sockaddr_in from; // where the last recv() came from
+		Subscriber subscribers[MAXSUBSCRIBERS]; // subscribers[0] is si_other
+		unsigned int nsubscribers;
 		char buf[BUFLEN];
+#ifdef _WIN32
 		WSADATA wsa;
-		Tactilus* t;
+#endif
+		FrameSource* source;
 		unsigned int rows, cols;
 
 		float presbuftosend[128] = { 0 }; // this is what to send when asked for it. This may allow for sending repeated data
-		float ringbuf[FORCEBUFLEN][128] = { 0 }; // this stores pressures in kPa
-		int ringbufwritehead;
+		std::chrono::steady_clock::time_point scantime; // when source->scan() last returned
+		float smoothed[128] = { 0 }; // newest scan after spatial smoothing in kPa
+		TemporalFilter* filter; // runs over consecutive smoothed frames
+		float avgkPa[128] = { 0 }; // each pad filtered over time in kPa, this is what the estimators read
+		StageTimes* timing = NULL; // where update() records its stages, if anywhere
 
 		// Note, in the reference frame, we define x as along the columns and y as along the rows
 		// the origin is in the top left. x increases as we go up, y increases as we go left, which
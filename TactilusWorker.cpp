@@ -0,0 +1,82 @@
+#include "TactilusWorker.h"
+
+namespace tactilus_udp
+{
+	AcquisitionWorker::AcquisitionWorker(std::function<void(SensorFrame& frame)> acquire)
+		: acquire(acquire), running(false), published(0), waiters(0)
+	{
+		this->handoff.writebuffer().number = 0;
+		this->handoff.publish();
+		this->handoff.fetch(); // so readbuffer() is frame number 0 until the first real frame
+	}
+
+	AcquisitionWorker::~AcquisitionWorker()
+	{
+		this->stop();
+	}
+
+	void AcquisitionWorker::start()
+	{
+		if (this->running.exchange(true)) {
+			return;
+		}
+		this->thread = std::thread(&AcquisitionWorker::run, this);
+	}
+
+	void AcquisitionWorker::stop()
+	{
+		this->running = false;
+		if (this->thread.joinable()) {
+			this->thread.join();
+		}
+	}
+
+	const SensorFrame& AcquisitionWorker::waitframe(unsigned long& lastseen)
+	{
+		while (1)
+		{
+			this->handoff.fetch();
+			const NumberedFrame& latest = this->handoff.readbuffer();
+			if (latest.number > lastseen) {
+				lastseen = latest.number;
+				return latest.frame;
+			}
+
+			// Nothing new yet, sleep until the worker publishes. waiters goes up before published is checked
+			// and the worker checks waiters after storing published, so one of the two always sees the other.
+			this->waiters++;
+			{
+				std::unique_lock<std::mutex> lock(this->mutex);
+				this->ready.wait(lock, [&] { return this->published.load() > lastseen; });
+			}
+			this->waiters--;
+		}
+	}
+
+	const SensorFrame& AcquisitionWorker::latestframe(unsigned long& number)
+	{
+		this->handoff.fetch();
+		number = this->handoff.readbuffer().number;
+		return this->handoff.readbuffer().frame;
+	}
+
+	void AcquisitionWorker::run()
+	{
+		unsigned long number = 0;
+		while (this->running)
+		{
+			NumberedFrame& next = this->handoff.writebuffer();
+			this->acquire(next.frame); // the slow part (the vendor scan), straight into the buffer that gets handed over
+			next.number = ++number;
+			this->handoff.publish();
+			this->published.store(number);
+			if (this->waiters.load() > 0) {
+				// Taking the lock makes sure the consumer is either still before its check of published or already asleep
+				{
+					std::lock_guard<std::mutex> lock(this->mutex);
+				}
+				this->ready.notify_all();
+			}
+		}
+	}
+}
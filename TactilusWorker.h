@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "TactilusKinetics.h"
+#include "TactilusHandoff.h"
+
+namespace tactilus_udp {
+	// One averaged frame of a sensor and when it was scanned
+	struct SensorFrame
+	{
+		float kPa[NUMPADS];
+		unsigned long long scantimeus; // steady clock microseconds, see TactilusUDP::getscantimeus()
+		KineticsResult kinetics; // of kPa, computed on the acquiring thread when whoever fills in the frame asks for it (Sender does)
+	};
+
+	// Long-lived thread that acquires frames from one sensor over and over and publishes the latest one.
+	// Replaces spawning and joining a std::thread per sensor every frame.
+	class AcquisitionWorker
+	{
+	public:
+		AcquisitionWorker(std::function<void(SensorFrame& frame)> acquire);
+		//  acquire is called in a loop on the worker thread. It should block until the sensor has a new frame
+		//  (e.g. TactilusUDP::update()) and fill in frame. Nothing runs until start()
+
+		~AcquisitionWorker();
+		//  Stops the thread if it is still running
+
+		void start();
+		//  Starts the worker thread
+
+		void stop();
+		//  Lets the current acquire finish, then joins the worker thread
+
+		const SensorFrame& waitframe(unsigned long& lastseen);
+		//  Blocks until a frame newer than frame number lastseen is published, sets lastseen to its number and returns it
+		//  Frame numbers start at 1, so passing 0 waits for the first frame
+		//  The frame stays valid and unchanged until the next waitframe() or latestframe() call. Only one thread may call these
+
+		const SensorFrame& latestframe(unsigned long& number);
+		//  The latest published frame without waiting, number is set to its frame number (0 if there is none yet)
+
+	private:
+		void run();
+
+		// What goes through the triple buffer, the frame with its number
+		struct NumberedFrame
+		{
+			SensorFrame frame;
+			unsigned long number;
+		};
+
+		std::function<void(SensorFrame&)> acquire;
+		std::thread thread;
+		std::atomic<bool> running;
+		TripleBuffer<NumberedFrame> handoff; // the worker never blocks handing a frame over
+		std::atomic<unsigned long> published; // number of the latest published frame
+		std::atomic<unsigned int> waiters; // consumers asleep in waitframe(), so the worker only touches the mutex when someone needs waking
+		std::mutex mutex; // only for sleeping on ready
+		std::condition_variable ready;
+	};
+};
@@ -0,0 +1,755 @@
+/*
+	Benchmarks of the sender's hot paths, and the receiver's kinetics, on synthetic frames, builds and runs without the Tactilus SDK
+	Usage: benchTactilus [iterations]
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "TactilusKinetics.h"
+#include "TactilusFilter.h"
+#include "TactilusMap.h"
+#include "TactilusHandoff.h"
+#include "TactilusHistogram.h"
+#include "TactilusPacket.h"
+#include "TactilusSender.h"
+#include "TactilusSmoothing.h"
+#include "TactilusSource.h"
+#include "TactilusUDP.h"
+#include "TactilusWorker.h"
+#include "LinuxUDP/TactilusKinetics_L.h"
+
+#define NUMFRAMES 64 // synthetic frames cycled through so the kernels don't see the same input every call
+#define FAKESCANUS 500 // how long a fake sensor scan blocks for
+
+#define BENCHPORT 29393 // loopback port the allocation check sends its packets to
+#define WARMUPPACKETS 200 // packets sent before allocations are counted
+#define BENCHSCANRATE 2000 // frames per second of the synthetic feet the Sender runs on
+#define BENCHPOINTS 8 // points the receiver takes moments about at once
+#define SMOOTHINGTOLERANCE 1e-4f // kPa a smoothing kernel may differ from smoothFrameReference by
+
+static float frames[NUMFRAMES][NUMPADS]; // raw pressures in psi, like Tactilus::matrix()
+static volatile float sink; // keeps the optimiser from throwing the benchmarked work away
+static std::atomic<unsigned long> allocations(0); // operator new calls on any thread
+
+// Counting allocator, the sender's steady state should never get here
+void* operator new(std::size_t size)
+{
+	++allocations;
+	void* p = malloc(size ? size : 1);
+	if (p == NULL) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+// Deterministic pseudo random numbers in [0, 1), so every run sees the same frames
+static float uniform()
+{
+	static unsigned int state = 12345;
+	state = state * 1664525u + 1013904223u;
+	return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+// A blob of pressure that moves from heel to toe over the frames, plus some noise
+static void makeFrames()
+{
+	for (unsigned int f = 0; f < NUMFRAMES; ++f)
+	{
+		float centre = 15.0f - 15.0f * f / (NUMFRAMES - 1);
+		for (unsigned int r = 0; r < PADROWS; ++r)
+		{
+			for (unsigned int c = 0; c < PADCOLS; ++c)
+			{
+				float d = (r - centre) * (r - centre) / 8.0f + (c - 3.5f) * (c - 3.5f) / 6.0f;
+				frames[f][r * PADCOLS + c] = 30.0f * std::exp(-d) + 0.5f * uniform();
+			}
+		}
+	}
+}
+
+// Runs work(frame) iterations times and returns nanoseconds per call
+template <typename Work>
+static double timeit(unsigned long iterations, Work work)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (unsigned long i = 0; i < iterations; ++i)
+	{
+		work(frames[i % NUMFRAMES]);
+	}
+	std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(stop - start).count() / iterations;
+}
+
+static void report(const char* name, double ns)
+{
+	printf("%-36s %10.1f ns/frame %14.0f frames/s\n", name, ns, 1e9 / ns);
+}
+
+// Times every smoothing kernel this build has, false if one differs from the reference by more than SMOOTHINGTOLERANCE
+static bool benchSmoothing(unsigned long iterations)
+{
+	bool ok = true;
+	const char* names[8];
+	tactilus_udp::SmoothingKernel kernels[8];
+	unsigned int n = tactilus_udp::smoothingKernels(names, kernels, 8);
+	float expected[NUMPADS];
+	float out[NUMPADS];
+
+	printf("smoothing (smoothFrame dispatches to %s)\n", tactilus_udp::smoothingBackend());
+	for (unsigned int k = 0; k < n; ++k)
+	{
+		// Largest difference from the original kernel over every synthetic frame [kPa]
+		float maxdiff = 0;
+		for (unsigned int f = 0; f < NUMFRAMES; ++f)
+		{
+			tactilus_udp::smoothFrameReference(frames[f], expected);
+			kernels[k](frames[f], out);
+			for (unsigned int i = 0; i < NUMPADS; ++i)
+			{
+				maxdiff = std::fmax(maxdiff, std::fabs(out[i] - expected[i]));
+			}
+		}
+
+		tactilus_udp::SmoothingKernel kernel = kernels[k];
+		double ns = timeit(iterations, [&](const float* frame) { kernel(frame, out); sink = out[17]; });
+		char label[64];
+		snprintf(label, sizeof(label), "  %s (max diff %.2g kPa)", names[k], maxdiff);
+		report(label, ns);
+		if (!(maxdiff <= SMOOTHINGTOLERANCE)) {
+			printf("  %s differs from the reference by more than %g kPa: FAILED\n", names[k], SMOOTHINGTOLERANCE);
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+// Every pad of the frame at the same pressure
+static void fillFrame(float* frame, float kPa)
+{
+	for (unsigned int i = 0; i < NUMPADS; ++i)
+	{
+		frame[i] = kPa;
+	}
+}
+
+// Delay of the filter's response to a 0 to 100 kPa step, in frames until the output gets to 50% and to 90%
+static void stepDelay(tactilus_udp::TemporalFilter* filter, double& half, double& ninety)
+{
+	float in[NUMPADS], out[NUMPADS];
+	filter->reset();
+	fillFrame(in, 0);
+	for (unsigned int n = 0; n < 2 * MAXFILTERLEN; ++n)
+	{
+		filter->filter(in, out);
+	}
+	fillFrame(in, 100);
+	half = -1;
+	ninety = -1;
+	for (unsigned int n = 0; n < 4 * MAXFILTERLEN && ninety < 0; ++n)
+	{
+		filter->filter(in, out);
+		if (half < 0 && out[0] >= 50) {
+			half = n;
+		}
+		if (ninety < 0 && out[0] >= 90) {
+			ninety = n;
+		}
+	}
+}
+
+// Gain and delay [ms] of the filter for a sine of hz around 50 kPa, sampled at rate
+static void sineResponse(tactilus_udp::TemporalFilter* filter, double hz, double rate, double& gain, double& delayms)
+{
+	float in[NUMPADS], out[NUMPADS];
+	const unsigned int settle = 500, n = 500; // n covers whole periods for the frequencies used below
+	double s = 0, c = 0;
+	filter->reset();
+	for (unsigned int i = 0; i < settle + n; ++i)
+	{
+		double w = 2 * 3.14159265358979 * hz * i / rate;
+		fillFrame(in, (float)(50 + 20 * std::sin(w)));
+		filter->filter(in, out);
+		if (i >= settle) {
+			s = s + (out[0] - 50) * std::sin(w);
+			c = c + (out[0] - 50) * std::cos(w);
+		}
+	}
+	// out = A sin(w - phase): the sin part is A cos(phase), the cos part -A sin(phase)
+	s = 2 * s / n;
+	c = 2 * c / n;
+	gain = std::sqrt(s * s + c * c) / 20;
+	delayms = std::atan2(-c, s) / (2 * 3.14159265358979 * hz) * 1000;
+}
+
+// Cost per frame of each temporal filter, and how much delay each adds on synthetic data
+// False if pass-through delays at all, or EMA, one-euro or Savitzky-Golay settle no sooner than the sender's 32 frame boxcar
+static bool benchFilters(unsigned long iterations)
+{
+	const char* specs[] = { "none", "boxcar:32", "boxcar:8", "ema:0.3", "fir:6", "oneeuro", "savgol:9:2", "savgol:15:3" };
+	const unsigned int nspecs = sizeof(specs) / sizeof(specs[0]);
+	const double rate = 250;
+	double ninetys[nspecs], delays[nspecs]; // step frames to 90% and 2 Hz delay [ms] of each
+	bool ok = true;
+	printf("temporal filters at %.0f Hz: cost, step response (frames to 50%%/90%%), sine gain and delay\n", rate);
+	for (unsigned int f = 0; f < nspecs; ++f)
+	{
+		tactilus_udp::FilterParams params;
+		params.rate = (float)rate;
+		tactilus_udp::parseFilter(specs[f], params);
+		tactilus_udp::TemporalFilter* filter = tactilus_udp::makeFilter(params);
+
+		float out[NUMPADS];
+		double ns = timeit(iterations, [&](const float* frame) { filter->filter(frame, out); sink = out[17]; });
+		double half, ninety, gain2, delay2, gain8, delay8;
+		stepDelay(filter, half, ninety);
+		sineResponse(filter, 2, rate, gain2, delay2);
+		sineResponse(filter, 8, rate, gain8, delay8);
+		printf("  %-12s %7.1f ns/frame   step %3.0f/%3.0f frames   2 Hz x%.2f %5.1f ms   8 Hz x%.2f %5.1f ms\n",
+			specs[f], ns, half, ninety, gain2, delay2, gain8, delay8);
+		delete filter;
+		ninetys[f] = ninety;
+		delays[f] = delay2;
+		if (f == 0 && (half != 0 || ninety != 0 || std::fabs(delay2) > 0.5 || std::fabs(delay8) > 0.5)) {
+			printf("  none delays its input: FAILED\n");
+			ok = false;
+		}
+	}
+	// specs[1] is the boxcar
+	for (unsigned int f = 0; f < nspecs; ++f)
+	{
+		bool fast = strncmp(specs[f], "ema", 3) == 0 || strncmp(specs[f], "oneeuro", 7) == 0 || strncmp(specs[f], "savgol", 6) == 0;
+		if (fast && !(ninetys[f] >= 0 && ninetys[f] < ninetys[1] && delays[f] < delays[1])) {
+			printf("  %s settles no sooner than %s: FAILED\n", specs[f], specs[1]);
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+// Fake sensor scan: blocks like the vendor scan() does, then smooths a synthetic frame
+static void fakeScan(const float* frame, float* out)
+{
+	std::this_thread::sleep_for(std::chrono::microseconds(FAKESCANUS));
+	tactilus_udp::smoothFrame(frame, out);
+}
+
+// Two fake sensors: a new std::thread per sensor per frame (how updateandsend used to work)
+// against one AcquisitionWorker per sensor. Both pay the fake scan time, the difference is thread handling.
+static void benchWorkers(unsigned long iterations)
+{
+	float out[2][NUMPADS];
+	printf("acquisition threads, 2 fake sensors taking %d us per scan\n", FAKESCANUS);
+
+	double ns = timeit(iterations, [&](const float* frame) {
+		std::thread x([&] { fakeScan(frame, out[0]); });
+		std::thread y([&] { fakeScan(frame, out[1]); });
+		x.join();
+		y.join();
+		sink = out[0][17] + out[1][17];
+	});
+	report("  thread per sensor per frame", ns);
+
+	unsigned long scans[2] = { 0, 0 };
+	tactilus_udp::AcquisitionWorker* workers[2];
+	for (unsigned int i = 0; i < 2; ++i)
+	{
+		unsigned long* count = &scans[i];
+		workers[i] = new tactilus_udp::AcquisitionWorker([count](tactilus_udp::SensorFrame& frame) {
+			fakeScan(frames[*count % NUMFRAMES], frame.kPa);
+			++*count;
+		});
+		workers[i]->start();
+	}
+	unsigned long lastframe[2] = { 0, 0 };
+	ns = timeit(iterations, [&](const float*) {
+		const tactilus_udp::SensorFrame& a = workers[0]->waitframe(lastframe[0]);
+		const tactilus_udp::SensorFrame& b = workers[1]->waitframe(lastframe[1]);
+		sink = a.kPa[17] + b.kPa[17];
+	});
+	report("  persistent AcquisitionWorker", ns);
+	for (unsigned int i = 0; i < 2; ++i)
+	{
+		delete workers[i];
+	}
+}
+
+// What the sender does per frame minus the wait for the insole and the sendto: scan a synthetic gait frame,
+// smooth it and update the running average (update()), take the averaged frame, compute the kinetics and encode the packet
+static void benchPipeline(unsigned long iterations)
+{
+	tactilus_udp::GaitParams gait;
+	gait.realtime = false;
+	tactilus_udp::SyntheticGaitSource* source = new tactilus_udp::SyntheticGaitSource(gait);
+	tactilus_udp::TactilusUDP tact(source, "127.0.0.1", 0, 9, 0); // never sends, the socket is only opened
+	tactilus_udp::SensorFrame frame;
+	tactilus_udp::KineticsRequest req;
+	tactilus_udp::KineticsResult res;
+	float values[MAXFIELDS];
+	unsigned char packet[MAXPACKETLEN];
+	req.x1 = 10;
+	req.y1 = 5;
+
+	printf("sender pipeline on SyntheticGaitSource (%.0f Hz, %.1f s strides)\n", gait.scanrate, gait.stridetime);
+	double ns = timeit(iterations, [&](const float*) { source->scan(); sink = source->matrix()[17]; });
+	report("  synthetic gait frame", ns);
+	ns = timeit(iterations, [&](const float*) { tact.update(); });
+	report("  update()", ns);
+	ns = timeit(iterations, [&](const float*) {
+		tact.update();
+		tact.getframe(frame);
+		tact.estimateKinetics(frame, req, res);
+		unsigned int n = tactilus_udp::packKinetics(res, tactilus_udp::DEFAULTFIELDS, values);
+		sink = (float)tactilus_udp::encodePacket(packet, sizeof(packet), 1, tactilus_udp::DEFAULTFIELDS, 0, frame.scantimeus, values) + n;
+	});
+	report("  update + kinetics + encode", ns);
+}
+
+// The estimate* functions of TactilusUDP on a walking frame, and computeKinetics with the requests the sa_* functions
+// of testTwoSensors make (they are computeKinetics on a global area table, and live in its main translation unit)
+static void benchKinetics(unsigned long iterations)
+{
+	tactilus_udp::GaitParams gait;
+	gait.realtime = false;
+	tactilus_udp::TactilusUDP tact(new tactilus_udp::SyntheticGaitSource(gait), "127.0.0.1", 0, 9, 0);
+	for (unsigned int i = 0; i < 100; ++i)
+	{
+		tact.update(); // into the stance phase, with the filter warmed up
+	}
+	double out[3 + MAXPADREQ];
+	u_int padx[2] = { 13, 2 };
+	u_int pady[2] = { 2, 4 };
+
+	printf("kinetics on the averaged frame\n");
+	report("  estimateForce", timeit(iterations, [&](const float*) { sink = (float)tact.estimateForce(); }));
+	report("  estimateCoP", timeit(iterations, [&](const float*) { tact.estimateCoP(out); sink = (float)out[0]; }));
+	report("  estimateMoment_y", timeit(iterations, [&](const float*) { sink = (float)tact.estimateMoment_y(10); }));
+	report("  estimateForceAndMoment_y", timeit(iterations, [&](const float*) { tact.estimateForceAndMoment_y(10, out); sink = (float)out[1]; }));
+	report("  estimateForceAndMoment_yx", timeit(iterations, [&](const float*) { tact.estimateForceAndMoment_yx(10, 5, out); sink = (float)out[2]; }));
+	report("  ..._yx_somepadforces (2 pads)", timeit(iterations, [&](const float*) { tact.estimateForceAndMoment_yx_somepadforces(10, 5, padx, pady, 2, out); sink = (float)out[4]; }));
+	report("  ..._yx_frontbackforces", timeit(iterations, [&](const float*) { tact.estimateForceAndMoment_yx_frontbackforces(10, 5, out); sink = (float)out[4]; }));
+
+	// The sender's own pad areas, partial and dead pads included
+	double areas[PADROWS][PADCOLS];
+	for (unsigned int r = 0; r < PADROWS; ++r)
+	{
+		for (unsigned int c = 0; c < PADCOLS; ++c)
+		{
+			areas[r][c] = tact.getpadarea(r, c);
+		}
+	}
+	tactilus_udp::KineticsRequest plain;
+	tactilus_udp::KineticsRequest moments;
+	moments.x1 = 10;
+	moments.y1 = 5;
+	tactilus_udp::KineticsResult res;
+	report("  computeKinetics (sa_estimateForce)", timeit(iterations, [&](const float* frame) {
+		tactilus_udp::computeKinetics(frame, areas, plain, res);
+		sink = (float)res.force;
+	}));
+	report("  computeKinetics (sa_..._yx)", timeit(iterations, [&](const float* frame) {
+		tactilus_udp::computeKinetics(frame, areas, moments, res);
+		sink = (float)res.momentx;
+	}));
+
+	// Kernels specialised to a subscription, checked against computeKinetics on what they send
+	const char* specs[] = { "force", "force+momenty+momentx", "default", "copx+copy", "force+contactarea+peakkpa" };
+	float maxdiff = 0;
+	for (unsigned int k = 0; k < sizeof(specs) / sizeof(specs[0]); ++k)
+	{
+		uint32_t fields = 0;
+		tactilus_udp::parseFields(specs[k], fields);
+		tactilus_udp::KineticsKernel kernel = tactilus_udp::kineticsKernel(fields);
+		float expected[MAXFIELDS];
+		float got[MAXFIELDS];
+		for (unsigned int f = 0; f < NUMFRAMES; ++f)
+		{
+			tactilus_udp::computeKinetics(frames[f], areas, moments, res);
+			unsigned int n = tactilus_udp::packKinetics(res, fields, expected);
+			kernel(frames[f], areas, moments, res);
+			tactilus_udp::packKinetics(res, fields, got);
+			for (unsigned int i = 0; i < n; ++i)
+			{
+				maxdiff = std::fmax(maxdiff, std::fabs(got[i] - expected[i]));
+			}
+		}
+		double ns = timeit(iterations, [&](const float* frame) { kernel(frame, areas, moments, res); sink = (float)res.force; });
+		char label[64];
+		snprintf(label, sizeof(label), "  kernel %s", specs[k]);
+		report(label, ns);
+	}
+	printf("  kernels differ from computeKinetics by at most %.2g\n", maxdiff);
+}
+
+// Comma separated text the way the receiver used to parse it: commas to spaces, then a stringstream
+static unsigned int parseText(const char* text, float* values, unsigned int maxvalues)
+{
+	std::string s(text);
+	std::replace(s.begin(), s.end(), ',', ' ');
+	std::stringstream ss(s);
+	unsigned int n = 0;
+	float v;
+	while (n < maxvalues && ss >> v)
+	{
+		values[n] = v;
+		++n;
+	}
+	return n;
+}
+
+// Getting two sensors' kinetics onto the wire and back off it: the comma separated text updateandsend used to build
+// with std::to_string and TactilusUDP_L parsed with a stringstream, against the binary packet. Plus allpressurepads().
+static void benchWire(unsigned long iterations)
+{
+	tactilus_udp::GaitParams gait;
+	gait.realtime = false;
+	tactilus_udp::TactilusUDP tact(new tactilus_udp::SyntheticGaitSource(gait), "127.0.0.1", 0, 9, 0);
+	for (unsigned int i = 0; i < 100; ++i)
+	{
+		tact.update();
+	}
+	tactilus_udp::KineticsRequest req;
+	tactilus_udp::KineticsResult res;
+	req.x1 = 10;
+	req.y1 = 5;
+	tact.estimateKinetics(req, res);
+	float values[2 * MAXFIELDS];
+	unsigned int n = tactilus_udp::packKinetics(res, tactilus_udp::DEFAULTFIELDS, values);
+	memcpy(values + n, values, n * sizeof(float)); // the second foot
+	n = 2 * n;
+
+	std::string text;
+	float decoded[2 * MAXFIELDS];
+	tactilus_udp::PacketHeader hdr;
+	printf("wire format, %u values for 2 sensors\n", n);
+	report("  text: std::to_string and append", timeit(iterations, [&](const float*) {
+		text = std::to_string(values[0]);
+		for (unsigned int i = 1; i < n; ++i)
+		{
+			text.append(",");
+			text.append(std::to_string(values[i]));
+		}
+		sink = (float)text.size();
+	}));
+	unsigned long before = allocations.load();
+	report("  text: stringstream parse", timeit(iterations, [&](const float*) { sink = (float)parseText(text.c_str(), decoded, 2 * MAXFIELDS); }));
+	double streamallocs = (double)(allocations.load() - before) / iterations;
+	before = allocations.load();
+	report("  text: scanFloats", timeit(iterations, [&](const float*) {
+		sink = (float)tactilus_udp::scanFloats(text.c_str(), (unsigned int)text.size(), decoded, 2 * MAXFIELDS);
+	}));
+	double scanallocs = (double)(allocations.load() - before) / iterations;
+	float streamed[2 * MAXFIELDS];
+	unsigned int nstream = parseText(text.c_str(), streamed, 2 * MAXFIELDS);
+	unsigned int nscan = tactilus_udp::scanFloats(text.c_str(), (unsigned int)text.size(), decoded, 2 * MAXFIELDS);
+	unsigned int differ = nstream == nscan ? 0 : 1;
+	for (unsigned int i = 0; i < nstream && i < nscan; ++i)
+	{
+		differ = decoded[i] == streamed[i] ? differ : differ + 1;
+	}
+	printf("  %.1f allocations per stringstream parse, %.1f per scanFloats, %u values differ\n", streamallocs, scanallocs, differ);
+	// A packet per synthetic frame, so the optimiser can't hoist either direction out of the loop
+	static unsigned char packets[NUMFRAMES][MAXPACKETLEN];
+	int packetlen = 0;
+	report("  binary: encodePacket", timeit(iterations, [&](const float* frame) {
+		unsigned char* packet = packets[(frame - frames[0]) / NUMPADS];
+		packetlen = tactilus_udp::encodePacket(packet, MAXPACKETLEN, 2, tactilus_udp::DEFAULTFIELDS, 0, 0, frame);
+		sink = packet[packetlen - 1];
+	}));
+	report("  binary: decodePacket", timeit(iterations, [&](const float* frame) {
+		tactilus_udp::decodePacket(packets[(frame - frames[0]) / NUMPADS], packetlen, hdr, decoded, 2 * MAXFIELDS);
+		sink = decoded[n - 1];
+	}));
+	printf("  %u bytes of text, %d byte packet\n", (unsigned int)text.size(), packetlen);
+	report("  allpressurepads()", timeit(iterations / 100, [&](const float*) { sink = (float)tact.allpressurepads().size(); }));
+}
+
+// Whole pressure maps of two walking feet as a sender with map=key or map=delta streams them: bytes per packet,
+// cost of appending and decoding them, and the largest difference from the averaged frames after the round trip
+static void benchMaps(unsigned long iterations)
+{
+	// Consecutive averaged frames of both feet, the way the workers hand them to the Sender
+	static float walk[NUMFRAMES * 4][2][NUMPADS];
+	for (unsigned int foot = 0; foot < 2; ++foot)
+	{
+		tactilus_udp::GaitParams gait;
+		gait.realtime = false;
+		gait.seed = foot + 1;
+		gait.phase = 0.5 * foot;
+		tactilus_udp::TactilusUDP tact(new tactilus_udp::SyntheticGaitSource(gait), "127.0.0.1", 0, 9, 0);
+		tactilus_udp::SensorFrame frame;
+		for (unsigned int f = 0; f < NUMFRAMES * 4; ++f)
+		{
+			tact.update();
+			tact.getframe(frame);
+			memcpy(walk[f][foot], frame.kPa, sizeof(frame.kPa));
+		}
+	}
+
+	tactilus_udp::KineticsResult res = tactilus_udp::KineticsResult();
+	float values[2 * MAXFIELDS];
+	unsigned int n = tactilus_udp::packKinetics(res, tactilus_udp::DEFAULTFIELDS, values);
+	memcpy(values + n, values, n * sizeof(float));
+	static unsigned char packets[NUMFRAMES * 4][MAXMAPPACKETLEN];
+	static int lens[NUMFRAMES * 4];
+	float decoded[2 * MAPPADS];
+
+	// Pads TactilusUDP gives no area, which the Sender always sends as 0
+	bool dead[MAPPADS];
+	{
+		tactilus_udp::GaitParams gait;
+		tactilus_udp::TactilusUDP tact(new tactilus_udp::SyntheticGaitSource(gait), "127.0.0.1", 0, 9, 0);
+		for (unsigned int pad = 0; pad < MAPPADS; ++pad)
+		{
+			dead[pad] = tact.getpadarea(pad / PADCOLS, pad % PADCOLS) == 0;
+		}
+	}
+
+	printf("pressure maps, 2 walking feet\n");
+	const char* names[3] = { "key", "delta", "delta, 5 kPa floor" };
+	for (unsigned int mode = 0; mode < 3; ++mode)
+	{
+		tactilus_udp::MapEncoder encoder;
+		encoder.setkeyinterval(mode == 0 ? 1 : MAPKEYINTERVAL);
+		encoder.setfloor(mode == 2 ? 5.0f : 0);
+		for (unsigned int pad = 0; pad < MAPPADS; ++pad)
+		{
+			encoder.setdead(pad, dead[pad]);
+		}
+		tactilus_udp::MapDecoder decoder;
+		unsigned long bytes = 0;
+		float maxdiff = 0;
+		for (unsigned int f = 0; f < NUMFRAMES * 4; ++f)
+		{
+			const float* maps[2] = { walk[f][0], walk[f][1] };
+			int len = tactilus_udp::encodePacket(packets[f], MAXMAPPACKETLEN, 2, tactilus_udp::DEFAULTFIELDS, f, 0, values);
+			lens[f] = encoder.append(packets[f], len, MAXMAPPACKETLEN, 2, maps);
+			bytes = bytes + lens[f];
+			if (decoder.decode(packets[f], lens[f], decoded, 2) != 2) {
+				maxdiff = INFINITY;
+				continue;
+			}
+			for (unsigned int i = 0; i < 2 * MAPPADS; ++i)
+			{
+				float sent = dead[i % MAPPADS] || walk[f][i / MAPPADS][i % MAPPADS] < (mode == 2 ? 5.0f : 0) ? 0 : walk[f][i / MAPPADS][i % MAPPADS];
+				maxdiff = std::fmax(maxdiff, std::fabs(decoded[i] - sent));
+			}
+		}
+
+		unsigned long f = 0;
+		double ns = timeit(iterations, [&](const float*) {
+			unsigned int at = f % (NUMFRAMES * 4);
+			const float* maps[2] = { walk[at][0], walk[at][1] };
+			sink = (float)encoder.append(packets[at], PACKETHEADERLEN + 8 * n, MAXMAPPACKETLEN, 2, maps);
+			++f;
+		});
+		char label[64];
+		snprintf(label, sizeof(label), "  %s: append both maps", names[mode]);
+		report(label, ns);
+		f = 0;
+		ns = timeit(iterations, [&](const float*) {
+			unsigned int at = f % (NUMFRAMES * 4);
+			sink = (float)decoder.decode(packets[at], lens[at], decoded, 2) + decoded[17];
+			++f;
+		});
+		snprintf(label, sizeof(label), "  %s: decode both maps", names[mode]);
+		report(label, ns);
+		printf("  %s: %.0f bytes per packet on average, largest error %.3f kPa\n", names[mode], (double)bytes / (NUMFRAMES * 4), maxdiff);
+	}
+}
+
+// The receiver's KineticsEngine on whole frames, checked against computeKinetics with the sender's pad areas
+static void benchReceiverKinetics(unsigned long iterations)
+{
+	tactilus_udp::GaitParams gait;
+	gait.realtime = false;
+	tactilus_udp::TactilusUDP tact(new tactilus_udp::SyntheticGaitSource(gait), "127.0.0.1", 0, 9, 0);
+	double areas[PADROWS][PADCOLS];
+	for (unsigned int r = 0; r < PADROWS; ++r)
+	{
+		for (unsigned int c = 0; c < PADCOLS; ++c)
+		{
+			areas[r][c] = tact.getpadarea(r, c);
+		}
+	}
+	tactilus_udp_linux::KineticsEngine engine; // its own copy of the sender's areas, that is what is checked here
+	engine.setcontact(5);
+	tactilus_udp::KineticsRequest req;
+	req.x1 = 10;
+	req.y1 = 5;
+	req.contactkPa = 5;
+	tactilus_udp::KineticsResult res;
+	tactilus_udp_linux::FrameKinetics k;
+	tactilus_udp_linux::FrameKinetics scalar;
+	double maxdiff = 0; // relative to the frame's force, or to its force times the insole length for moments
+	for (unsigned int f = 0; f < NUMFRAMES; ++f)
+	{
+		tactilus_udp::computeKinetics(frames[f], areas, req, res);
+		engine.compute(frames[f], k);
+		engine.computeScalar(frames[f], scalar);
+		double diffs[] = { (k.force - res.force) / res.force, (k.frontforce - res.frontforce) / res.force,
+			(k.copx() - res.copx) / INSOLELENGTH, (k.copy() - res.copy) / INSOLEWIDTH,
+			(k.momentyat(10) - res.momenty) * 1000 / (res.force * INSOLELENGTH), (k.momentxat(5) - res.momentx) * 1000 / (res.force * INSOLELENGTH),
+			(k.contactarea - res.contactarea) / (PADLENGTH * PADWIDTH), k.peakkPa - res.peakkPa, (scalar.force - k.force) / res.force };
+		for (unsigned int i = 0; i < sizeof(diffs) / sizeof(diffs[0]); ++i)
+		{
+			maxdiff = std::fmax(maxdiff, std::fabs(diffs[i]));
+		}
+	}
+
+	tactilus_udp_linux::RefPoint points[BENCHPOINTS];
+	for (unsigned int i = 0; i < BENCHPOINTS; ++i)
+	{
+		points[i].x = 10.0f + 30.0f * i;
+		points[i].y = 5.0f + 10.0f * i;
+	}
+	float moments[2 * BENCHPOINTS];
+	char label[64];
+	printf("receiver kinetics on whole frames\n");
+	report("  computeKinetics (sender)", timeit(iterations, [&](const float* frame) {
+		tactilus_udp::computeKinetics(frame, areas, req, res);
+		sink = (float)res.momentx;
+	}));
+	report("  KineticsEngine scalar", timeit(iterations, [&](const float* frame) { engine.computeScalar(frame, k); sink = k.force; }));
+	snprintf(label, sizeof(label), "  KineticsEngine %s", engine.backend());
+	report(label, timeit(iterations, [&](const float* frame) { engine.compute(frame, k); sink = k.force; }));
+	snprintf(label, sizeof(label), "  KineticsEngine %s + %u points", engine.backend(), BENCHPOINTS);
+	report(label, timeit(iterations, [&](const float* frame) {
+		engine.compute(frame, k);
+		k.moments(points, BENCHPOINTS, moments);
+		sink = moments[2 * BENCHPOINTS - 1];
+	}));
+	printf("  differs from computeKinetics by at most %.2g (relative)\n", maxdiff);
+}
+
+// Runs a Sender on two synthetic feet (scanning at BENCHSCANRATE so it doesn't take long) and counts heap allocations
+// per packet once it is warmed up, on every thread: acquisition, smoothing, averaging, kinetics, encoding, sendto,
+// and the stage timings going out to the side port the way testTwoSensors sends them. Returns false if there were any.
+static bool benchAllocations(unsigned long packets)
+{
+	std::vector<tactilus_udp::TactilusUDP*> tacts;
+	for (unsigned int i = 0; i < 2; ++i)
+	{
+		tactilus_udp::GaitParams gait;
+		gait.scanrate = BENCHSCANRATE;
+		gait.seed = i + 1;
+		gait.phase = 0.5 * i;
+		tacts.push_back(new tactilus_udp::TactilusUDP(new tactilus_udp::SyntheticGaitSource(gait), "127.0.0.1", 0, BENCHPORT, i == 0));
+	}
+	// Somewhere for the packets to go, so the sends don't fail with port unreachable
+	tactilus_udp::GaitParams idle;
+	tactilus_udp::TactilusUDP receiver(new tactilus_udp::SyntheticGaitSource(idle), "127.0.0.1", BENCHPORT, 0, 1);
+
+	tactilus_udp::KineticsRequest req;
+	req.x1 = 10;
+	req.y1 = 5;
+	unsigned long counted;
+	{
+		tactilus_udp::Sender sender(tacts, req, tactilus_udp::DEFAULTFIELDS);
+		sender.start();
+		for (unsigned long i = 0; i < WARMUPPACKETS; ++i)
+		{
+			sender.sendnext();
+		}
+		sender.gettiming().reset();
+		char timing[512];
+		unsigned long before = allocations.load();
+		for (unsigned long i = 1; i <= packets; ++i)
+		{
+			sender.sendnext();
+			if (i % 1000 == 0) {
+				int timinglen = sender.gettiming().format(timing, sizeof(timing));
+				tacts[0]->send(timing, timinglen, BENCHPORT);
+			}
+		}
+		counted = allocations.load() - before;
+		sender.stop();
+
+		tactilus_udp::SenderStats stats = sender.getstats();
+		printf("\nsender pipeline, 2 synthetic feet at %d Hz\n", BENCHSCANRATE);
+		printf("  packets %lu sent %lu, frames skipped %lu, encode failed %lu, transmit queue full %lu\n  queue depth seen by each packet:", stats.packets, stats.sent, stats.skippedframes, stats.encodefailed, stats.queuefull);
+		for (unsigned int i = 0; i <= SENDQUEUELEN; ++i)
+		{
+			printf(" %lu", stats.queuedepth[i]);
+		}
+		printf("\n");
+		sender.gettiming().format(timing, sizeof(timing));
+		printf("  %s\n", timing);
+	}
+	for (unsigned int i = 0; i < tacts.size(); ++i)
+	{
+		delete tacts[i];
+	}
+
+	printf("steady state allocations: %lu in %lu packets (%.3f per packet) %s\n", counted, packets, (double)counted / packets, counted == 0 ? "ok" : "FAILED");
+	return counted == 0;
+}
+
+// Cost of handing a frame through the TripleBuffer with no contention, publish() then fetch() on one thread
+static void benchHandoff(unsigned long iterations)
+{
+	tactilus_udp::TripleBuffer<tactilus_udp::SensorFrame> handoff;
+	printf("frame handoff\n");
+	double ns = timeit(iterations, [&](const float* frame) {
+		handoff.writebuffer().kPa[17] = frame[17];
+		handoff.publish();
+		handoff.fetch();
+		sink = handoff.readbuffer().kPa[17];
+	});
+	report("  TripleBuffer publish + fetch", ns);
+}
+
+// Time from the worker publishing a frame to waitframe() returning it on the consumer thread,
+// the consumer sleeping in waitframe() between frames like updateandsend does
+static void benchHandoffLatency(unsigned long frames)
+{
+	tactilus_udp::Histogram latency;
+	tactilus_udp::AcquisitionWorker worker([](tactilus_udp::SensorFrame& frame) {
+		std::this_thread::sleep_for(std::chrono::microseconds(FAKESCANUS));
+		frame.scantimeus = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	});
+	worker.start();
+	unsigned long lastframe = 0;
+	for (unsigned long i = 0; i < frames; ++i)
+	{
+		const tactilus_udp::SensorFrame& frame = worker.waitframe(lastframe);
+		unsigned long long now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		latency.record(now - frame.scantimeus); // scantimeus carries nanoseconds here
+	}
+	worker.stop();
+	printf("  publish to waitframe() latency      p50 %llu ns, p99 %llu ns, max %llu ns over %llu frames\n",
+		(unsigned long long)latency.percentile(50), (unsigned long long)latency.percentile(99),
+		(unsigned long long)latency.max(), (unsigned long long)latency.count());
+}
+
+int main(int argc, char** argv)
+{
+	unsigned long iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+	makeFrames();
+	bool ok = benchSmoothing(iterations);
+	ok = benchFilters(iterations) && ok;
+	benchPipeline(iterations / 10);
+	benchKinetics(iterations);
+	benchWire(iterations / 10);
+	benchMaps(iterations / 10);
+	benchReceiverKinetics(iterations);
+	benchWorkers(iterations / 1000);
+	benchHandoff(iterations);
+	benchHandoffLatency(iterations / 1000);
+	ok = benchAllocations(iterations / 1000) && ok;
+	return ok ? 0 : 1;
+}
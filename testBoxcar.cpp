@@ -0,0 +1,64 @@
+/*
+	Checks TactilusUDP::update()'s running sum boxcar against the FORCEBUFLEN frame re-summing average the sender used to
+	compute, on the same synthetic frames, over many laps of the ring. Exits non-zero on the first pad that differs
+	Usage: testBoxcar [laps]
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "TactilusSmoothing.h"
+#include "TactilusSource.h"
+#include "TactilusUDP.h"
+#include "TactilusWorker.h"
+
+#define BOXCARTOLERANCE 1e-3f // kPa a pad may differ by, plus BOXCARRELTOLERANCE of its pressure
+#define BOXCARRELTOLERANCE 1e-5f
+
+int main(int argc, char** argv)
+{
+	unsigned long laps = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000;
+	tactilus_udp::GaitParams gait;
+	gait.realtime = false;
+	tactilus_udp::TactilusUDP tact(new tactilus_udp::SyntheticGaitSource(gait), "127.0.0.1", 0, 9, 0);
+	tactilus_udp::SyntheticGaitSource source(gait); // same seed, so the same frames as tact scans
+
+	// The old average: every smoothed frame in a ring of FORCEBUFLEN, all of them summed again for every frame
+	static float ringbuf[FORCEBUFLEN][NUMPADS] = { { 0 } };
+	int ringbufwritehead = 0;
+	float expected[NUMPADS];
+	tactilus_udp::SensorFrame frame;
+	float maxdiff = 0;
+	for (unsigned long n = 0; n < laps * FORCEBUFLEN; ++n)
+	{
+		tact.update();
+		tact.getframe(frame);
+
+		source.scan();
+		tactilus_udp::smoothFrame(source.matrix(), ringbuf[ringbufwritehead]);
+		ringbufwritehead = (ringbufwritehead + 1) % FORCEBUFLEN;
+		for (unsigned int head = 0; head < NUMPADS; ++head)
+		{
+			float avgcurrkPa = 0;
+			for (unsigned int i = 0; i < FORCEBUFLEN; ++i)
+			{
+				avgcurrkPa = avgcurrkPa + ringbuf[(ringbufwritehead - 1 + i) % FORCEBUFLEN][head];
+			}
+			expected[head] = avgcurrkPa / FORCEBUFLEN;
+		}
+
+		for (unsigned int i = 0; i < NUMPADS; ++i)
+		{
+			float diff = std::fabs(frame.kPa[i] - expected[i]);
+			maxdiff = diff > maxdiff ? diff : maxdiff;
+			if (diff > BOXCARTOLERANCE + BOXCARRELTOLERANCE * std::fabs(expected[i])) {
+				printf("FAIL: frame %lu (lap %lu), pad %u: running sum %f kPa, re-summed %f kPa\n",
+					n, n / FORCEBUFLEN, i, frame.kPa[i], expected[i]);
+				return 1;
+			}
+		}
+	}
+	printf("boxcar matches the re-summed average over %lu laps of %d frames, at most %.3g kPa apart\n", laps, FORCEBUFLEN, maxdiff);
+	return 0;
+}
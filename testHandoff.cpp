@@ -0,0 +1,178 @@
+/*
+	Stress test of the handoffs between threads: a writer stamps every frame it publishes with its number, a reader checks
+	that every frame it gets is whole (no pad from another frame) and newer than the one before. Build with
+	-DTACTILUS_TSAN=ON to have ThreadSanitizer watch as well. Exits non-zero on the first inconsistency
+	Usage: testHandoff [frames]
+*/
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "TactilusHandoff.h"
+#include "TactilusWorker.h"
+
+#define QUEUESLOTS 16 // small, so the queue runs full and empty often
+#define YIELDEVERY 4 // frames the TripleBuffer writer publishes between letting the reader run
+
+// Every pad and the scan time of frame number n carry n
+static void stamp(tactilus_udp::SensorFrame& frame, unsigned long n)
+{
+	for (unsigned int i = 0; i < NUMPADS; ++i)
+	{
+		frame.kPa[i] = (float)n;
+	}
+	frame.scantimeus = n;
+}
+
+// Whether frame is all from one stamp() call
+static bool whole(const tactilus_udp::SensorFrame& frame)
+{
+	for (unsigned int i = 0; i < NUMPADS; ++i)
+	{
+		if (frame.kPa[i] != (float)frame.scantimeus) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Writer publishes frames 1 ... frames as fast as it can, the reader fetches whatever is newest
+static bool testTripleBuffer(unsigned long frames)
+{
+	tactilus_udp::TripleBuffer<tactilus_udp::SensorFrame> handoff;
+	std::atomic<bool> done(false);
+	std::thread writer([&] {
+		for (unsigned long n = 1; n <= frames; ++n)
+		{
+			stamp(handoff.writebuffer(), n);
+			if (n % YIELDEVERY == 0) {
+				std::this_thread::yield(); // with the frame half handed over, so the reader runs then too on a single core
+			}
+			handoff.publish();
+		}
+		done.store(true);
+	});
+	unsigned long last = 0;
+	unsigned long fetched = 0;
+	bool ok = true;
+	while (ok)
+	{
+		bool finished = done.load(); // before fetch(), so the last frame is always fetched after it is set
+		if (handoff.fetch()) {
+			const tactilus_udp::SensorFrame& frame = handoff.readbuffer();
+			if (!whole(frame)) {
+				printf("FAIL: TripleBuffer frame %llu is torn\n", frame.scantimeus);
+				ok = false;
+			}
+			else if (frame.scantimeus <= last) {
+				printf("FAIL: TripleBuffer went from frame %lu back to %llu\n", last, frame.scantimeus);
+				ok = false;
+			}
+			last = (unsigned long)frame.scantimeus;
+			++fetched;
+		}
+		else if (finished) {
+			break;
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+	writer.join();
+	if (ok && last != frames) {
+		printf("FAIL: TripleBuffer's last frame was %lu, not %lu\n", last, frames);
+		ok = false;
+	}
+	printf("TripleBuffer: %lu frames published, %lu fetched %s\n", frames, fetched, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+// Every frame pushed has to come out, whole and in order
+static bool testSpscQueue(unsigned long frames)
+{
+	tactilus_udp::SpscQueue<tactilus_udp::SensorFrame, QUEUESLOTS> queue;
+	std::thread writer([&] {
+		for (unsigned long n = 1; n <= frames; )
+		{
+			tactilus_udp::SensorFrame* slot = queue.writeslot();
+			if (slot == NULL) {
+				std::this_thread::yield();
+				continue;
+			}
+			stamp(*slot, n);
+			queue.push();
+			++n;
+		}
+	});
+	bool ok = true;
+	for (unsigned long n = 1; n <= frames && ok; )
+	{
+		tactilus_udp::SensorFrame* slot = queue.readslot();
+		if (slot == NULL) {
+			std::this_thread::yield();
+			continue;
+		}
+		if (!whole(*slot) || slot->scantimeus != n) {
+			printf("FAIL: SpscQueue gave frame %llu where %lu was due\n", slot->scantimeus, n);
+			ok = false;
+		}
+		queue.pop();
+		++n;
+	}
+	writer.join();
+	printf("SpscQueue: %lu frames through %d slots %s\n", frames, QUEUESLOTS, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+// The worker's acquire stamps each frame with the number it will be published under, the consumer mixes
+// waitframe() and latestframe() like updateandsend and a monitoring thread would
+static bool testAcquisitionWorker(unsigned long frames)
+{
+	unsigned long acquired = 0; // only touched on the worker thread
+	tactilus_udp::AcquisitionWorker worker([&acquired](tactilus_udp::SensorFrame& frame) {
+		++acquired;
+		stamp(frame, acquired);
+	});
+	worker.start();
+	unsigned long lastseen = 0;
+	bool ok = true;
+	while (lastseen < frames && ok)
+	{
+		unsigned long before = lastseen;
+		unsigned long number = 0;
+		const tactilus_udp::SensorFrame* frame;
+		if (lastseen % 2) {
+			frame = &worker.latestframe(number);
+		}
+		else {
+			frame = &worker.waitframe(lastseen);
+			number = lastseen;
+		}
+		if (number == 0) {
+			continue;
+		}
+		if (!whole(*frame) || frame->scantimeus != number) {
+			printf("FAIL: AcquisitionWorker frame %lu holds frame %llu, or parts of others\n", number, frame->scantimeus);
+			ok = false;
+		}
+		else if (number < before) {
+			printf("FAIL: AcquisitionWorker went from frame %lu back to %lu\n", before, number);
+			ok = false;
+		}
+		lastseen = number;
+	}
+	worker.stop();
+	printf("AcquisitionWorker: up to frame %lu %s\n", lastseen, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned long frames = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+	bool ok = testTripleBuffer(frames);
+	ok = testSpscQueue(frames) && ok;
+	ok = testAcquisitionWorker(frames) && ok;
+	return ok ? 0 : 1;
+}
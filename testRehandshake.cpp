@@ -0,0 +1,125 @@
+/*
+	A sender restarting while the receive thread runs: two senders take turns handshaking with a TactilusUDP_L, so its
+	receive thread keeps changing the address send() goes to, while the caller sends to whichever shook hands last. Every
+	handshake has to be answered to the sender that made it, and every message the caller sends has to arrive at one of
+	them. Build with -DTACTILUS_TSAN=ON to have ThreadSanitizer watch as well. Exits non-zero if anything went missing
+	Usage: testRehandshake [handshakes]
+*/
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "TactilusUDP_L.h"
+
+#define REHANDSHAKEPORT 29393 // the TactilusUDP_L under test, on loopback
+#define PINGMSG "ping"
+#define SETTLEMS 100 // for the last messages to arrive before they are counted
+
+// A sender: a loopback socket on a port of its own, and what it got back
+struct Peer
+{
+	int s;
+	unsigned long handshakes = 0;
+	unsigned long replies = 0;
+	unsigned long pings = 0;
+};
+
+static bool openpeer(Peer& peer)
+{
+	peer.s = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+	return peer.s >= 0 && bind(peer.s, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+}
+
+static void handshake(Peer& peer)
+{
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(REHANDSHAKEPORT);
+	addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+	sendto(peer.s, HANDSHAKEMSG, strlen(HANDSHAKEMSG), 0, (struct sockaddr*)&addr, sizeof(addr));
+	peer.handshakes++;
+}
+
+// Counts what is waiting for peer: pings from the caller and answers to handshakes, heartbeats aside
+static void drain(Peer& peer)
+{
+	char msg[BUFLEN];
+	int len;
+	while ((len = (int)recv(peer.s, msg, sizeof(msg) - 1, MSG_DONTWAIT)) >= 0)
+	{
+		if (tactilus_udp::isControl(msg, len, PINGMSG)) {
+			peer.pings++;
+		}
+		else if (!tactilus_udp::isControl(msg, len, HEARTBEATMSG)) {
+			peer.replies++;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned long handshakes = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000;
+	Peer peers[2];
+	if (!openpeer(peers[0]) || !openpeer(peers[1])) {
+		printf("FAIL: no loopback sockets\n");
+		return 1;
+	}
+
+	// The first handshake gets the constructor going, the rest are answered on the receive thread
+	std::atomic<bool> started(false);
+	std::atomic<bool> done(false);
+	std::thread senders([&] {
+		while (!started.load())
+		{
+			handshake(peers[0]);
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			drain(peers[0]);
+		}
+		for (unsigned long n = 1; n < handshakes; ++n)
+		{
+			handshake(peers[n % 2]);
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+			drain(peers[0]);
+			drain(peers[1]);
+		}
+		done.store(true);
+	});
+	tactilus_udp_linux::TactilusUDP_L tact("127.0.0.1", REHANDSHAKEPORT, 10, 5, 1);
+	tact.startreceiving();
+	started.store(true);
+	unsigned long sent = 0;
+	while (!done.load())
+	{
+		tact.send(PINGMSG);
+		++sent;
+		std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+	senders.join();
+	std::this_thread::sleep_for(std::chrono::milliseconds(SETTLEMS));
+	tact.stopreceiving();
+	drain(peers[0]);
+	drain(peers[1]);
+
+	// handshakes sent by the first peer before the constructor listened are lost, every one after has an answer
+	bool ok = peers[1].replies == peers[1].handshakes && peers[0].replies >= 1 && peers[0].replies <= peers[0].handshakes
+		&& peers[0].pings + peers[1].pings == sent && peers[1].pings > 0;
+	for (unsigned int i = 0; i < 2; ++i)
+	{
+		printf("sender %u: %lu handshakes, %lu answered, %lu of the caller's messages\n", i, peers[i].handshakes, peers[i].replies, peers[i].pings);
+		close(peers[i].s);
+	}
+	printf("%lu messages sent while the senders took turns %s\n", sent, ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
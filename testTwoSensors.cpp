@@ -1,32 +1,39 @@
 /*
 	Simple udp client
 */
-#define _WINSOCK_DEPRECATED_NO_WARNINGS
-
 #include <iostream>
-#include "Tactilus.h"
+#include <cctype>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 #include <iostream>
 #include <sstream>
 #include <vector>
 
-#include<winsock2.h>
-#include<Ws2tcpip.h>
 #include<math.h>
 #include"TactilusUDP.h"
+#include"TactilusKinetics.h"
+#include"TactilusSmoothing.h"
+#include"TactilusPacket.h"
+#include"TactilusSender.h"
+#include"TactilusSession.h"
+#include"TactilusSource.h"
+#include"TactilusWorker.h"
 #include<chrono>
 #include<thread>
-#include <mutex>
 
 
+#ifdef _WIN32
 #pragma comment(lib,"ws2_32.lib") //Winsock Library
 #pragma comment(lib,"core.lib")
+#endif
 
 
 #define SERVER "10.7.0.11"		//ip address of bbb over usb
 #define SRCPORT 23498	//The port on which to send from for permissions(?) purposes
 #define DSTPORT 29292	//The port on which to send data to bbb
+#define STATSPACKETS 5000	//How often the pipeline stats are printed
 
 // Author:	Jehan Yang
 // Updated:	06/07/2022
@@ -40,737 +47,18 @@
 // V1.15: Found that the way to cause the fewest delays is to constantly send from Windows. Multithreading is unnecessary except for updating both at once (not for updating and waiting/sending). Also added ability to get specific pressure pad forces.
 // V1.16: Cleaned up code, deleted unnecessary comments and deleted some unused code. 
 
-namespace tactilus_udp
-{
-	TactilusUDP::TactilusUDP(const char* dest_address, u_int src_port, u_int dest_port)
-		//	Initialize everything as needed
-		/*	char* dest_address			IPv4 address destination written as a string
-		//	u_int src_port				local port that we are sending from (irrelevant if not communicator)
-		//	u_int dest_port				remote port that we are sending to (irrelevant if not communicator)
-		//  u_int communicator          1 if this sensor is the commmunicator (the sensor object sending and receiving messages) and 0 if it is not
-		*/
-	{
-		// This part initializes the Tactilus data querying object
-		this->t = new Tactilus();
-
-		printf("Connecting to Tactilus...");
-		t->connect(true); //do this first so that the next t->connect(true); doesn't take seconds to happen
-		printf("Connected.\n");
-
-		this->ringbufwritehead = 0;
-		this->rows = this->t->rowCount();
-		this->cols = this->t->columnCount();
-
-		// Makes float[][] that characterizes areas of each pad in mm^2
-		double padarea = 13.0 *17.2;
-		for (unsigned int i = 0; i < 16; ++i)
-		{
-			for (unsigned int j = 0; j < 8; ++j)
-			{
-				areas[i][j] = areas[i][j] * padarea;
-			}
-		}
-
-		//Initialize winsock
-		printf("\nInitialising Winsock...");
-		if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
-		{
-			printf("Failed. Error Code : %d", WSAGetLastError());
-			exit(EXIT_FAILURE);
-		}
-		printf("Initialised.\n");
-
-		//Create a socket
-		if ((s = socket(AF_INET, SOCK_DGRAM, 0)) == INVALID_SOCKET)
-		{
-			printf("Could not create socket : %d", WSAGetLastError());
-		}
-		printf("Socket created...");
-
-		//setup address structure
-		memset((char *)&si_other, 0, sizeof(si_other));
-		si_other.sin_family = AF_INET; // designates that we are using IPv4 addresses
-		si_other.sin_port = htons(dest_port);
-		si_other.sin_addr.s_addr = inet_addr(dest_address);
-
-		memset((char *)&srcaddr, 0, sizeof(srcaddr));
-		srcaddr.sin_family = AF_INET; // designates that we are using IPv4 addresses
-		srcaddr.sin_port = htons(src_port);
-		srcaddr.sin_addr.s_addr = htonl(INADDR_ANY);
-
-		//Bind, tying our socket to the srcaddr information (local IP address, source port)
-		if (bind(s, (struct sockaddr *)&srcaddr, sizeof(srcaddr)) == SOCKET_ERROR)
-		{
-			printf("Bind failed with error code : %d", WSAGetLastError());
-			exit(EXIT_FAILURE);
-		}
-		puts("Bind done...\n");
-
-		printf("Setting socket to non-blocking...");
-		u_long mode = 1;  // 1 to enable non-blocking socket, this allows recv to time out and not run forever
-		ioctlsocket(s, FIONBIO, &mode);
-		printf("Set.\n");
-
-	}
-
-	TactilusUDP::TactilusUDP(const char* dest_address, u_int src_port, u_int dest_port, u_int communicator)
-		//	Initialize everything as needed
-		/*	char* dest_address			IPv4 address destination written as a string
-		//	u_int src_port				local port that we are sending from (irrelevant if not communicator)
-		//	u_int dest_port				remote port that we are sending to (irrelevant if not communicator)
-		//  u_int communicator          1 if this sensor is the commmunicator (the sensor object sending and receiving messages) and 0 if it is not
-		*/
-	{
-		// This part initializes the Tactilus data querying object
-		this->t = new Tactilus();
-
-		printf("Connecting to Tactilus...");
-		t->connect(true); //do this first so that the next t->connect(true); doesn't take seconds to happen
-		printf("Connected.\n");
-
-		this->ringbufwritehead = 0;
-		this->rows = this->t->rowCount();
-		this->cols = this->t->columnCount();
-
-		// Makes float[][] that characterizes areas of each pad in mm^2
-		double padarea = 13.0 *17.2;
-		for (unsigned int i = 0; i < 16; ++i)
-		{
-			for (unsigned int j = 0; j < 8; ++j)
-			{
-				areas[i][j] = areas[i][j] * padarea;
-			}
-		}
-
-		//Initialize winsock
-		printf("\nInitialising Winsock...");
-		if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
-		{
-			printf("Failed. Error Code : %d", WSAGetLastError());
-			exit(EXIT_FAILURE);
-		}
-		printf("Initialised.\n");
-
-		//Create a socket
-		if ((s = socket(AF_INET, SOCK_DGRAM, 0)) == INVALID_SOCKET)
-		{
-			printf("Could not create socket : %d", WSAGetLastError());
-		}
-		printf("Socket created...");
-
-		//setup address structure
-		memset((char *)&si_other, 0, sizeof(si_other));
-		si_other.sin_family = AF_INET; // designates that we are using IPv4 addresses
-		si_other.sin_port = htons(dest_port);
-		si_other.sin_addr.s_addr = inet_addr(dest_address);
-
-		memset((char *)&srcaddr, 0, sizeof(srcaddr));
-		srcaddr.sin_family = AF_INET; // designates that we are using IPv4 addresses
-		srcaddr.sin_port = htons(src_port);
-		srcaddr.sin_addr.s_addr = htonl(INADDR_ANY);
-
-		//Bind, tying our socket to the srcaddr information (local IP address, source port)
-		if (bind(s, (struct sockaddr *)&srcaddr, sizeof(srcaddr)) == SOCKET_ERROR && communicator==1)
-		{
-			printf("Bind failed with error code : %d", WSAGetLastError());
-			exit(EXIT_FAILURE);
-		}
-
-		if (communicator == 1)
-		{
-			puts("Bind done...\n");
-			printf("Setting socket to non-blocking...");
-			u_long mode = 1;  // 1 to enable non-blocking socket, this allows recv to time out and not run forever (may not be necessary)
-			ioctlsocket(s, FIONBIO, &mode);
-			printf("Set.\n");
-		}	
-
-	}
-
-	TactilusUDP::~TactilusUDP()
-		//	Clean up Tactilus class
-	{
-		closesocket(s);
-		WSACleanup();
-	}
-
-	Tactilus * TactilusUDP::gettactilusid()
-	{
-		return this->t;
-	}
-
-	void TactilusUDP::send(std::string message)
-		//	Takes a message and sends it to dest_address with src_port and dest_port as initialized
-	{
-		if (sendto(s, message.c_str(), strlen(message.c_str()), 0, (struct sockaddr *) &si_other, slen) == SOCKET_ERROR)
-		{
-			printf("sendto() failed with error code : %d", WSAGetLastError());
-			exit(EXIT_FAILURE);
-		}
-	}
-
-	void TactilusUDP::recv()
-		//	Checks whether anything is in to be received to our address and src_port
-		//  If there isn't, then just leave after setting buf = all \0s
-	{
-		memset(buf, '\0', BUFLEN);
-
-		//auto start = std::chrono::high_resolution_clock::now();
-
-		if (recvfrom(s, buf, BUFLEN, 0, (struct sockaddr *) &si_other, &slen) == SOCKET_ERROR) // if you desire to block and repeatedly get pressure readings for one sensor (however, we want both sensors to update repeatedly), should use while instead of if
-
-		{
-			//auto start = std::chrono::high_resolution_clock::now(); // this was used for timing the clock
-
-
-			if (WSAGetLastError() == WSAEWOULDBLOCK) // I think this kind of error means nothing was received and recvfrom should repeat
-			{
-				// The following code is really just left over from 1.0, when only 1 sensor is used
-				// the reason for the following block of code is that this used to update indefinitely the ring buffer until some actual request is made. Now with two sensors, we don't want to block the other sensor from updating. 
-
-				//this->t->scan();
-				//float* value = t->matrix();
-				//for (unsigned int i = 0; i < 128; ++i, ++value) // Gaussian smoothing implementation
-				//{
-
-				//	if (i == 0) {
-				//		this->ringbuf[ringbufwritehead][i] = ((*value * (1.0f / 4) + *(value + 1) * (1.0f / 8) + *(value + 8) * (1.0f / 8) + *(value + 9) * (1.0f / 16)) * 6.8947572932f) * 16.0f / 9; // top left corner case
-				//	}
-				//	else if (i == 7) {
-				//		this->ringbuf[ringbufwritehead][i] = ((*value * (1.0f / 4) + *(value - 1) * (1.0f / 8) + *(value + 8) * (1.0f / 8) + *(value + 7) * (1.0f / 16)) * 6.8947572932f) * 16.0f / 9; // top right corner case
-				//	}
-				//	else if (i == 120) {
-				//		this->ringbuf[ringbufwritehead][i] = ((*value * (1.0f / 4) + *(value + 1) * (1.0f / 8) + *(value - 8) * (1.0f / 8) + *(value - 7) * (1.0f / 16)) * 6.8947572932f) * 16.0f / 9; // bottom left corner case
-				//	}
-				//	else if (i == 127) {
-				//		this->ringbuf[ringbufwritehead][i] = ((*value * (1.0f / 4) + *(value - 1) * (1.0f / 8) + *(value - 8) * (1.0f / 8) + *(value - 9) * (1.0f / 16)) * 6.8947572932f) * 16.0f / 9; // bottom right corner case
-				//	}
-				//	else if (i < 8) {
-				//		this->ringbuf[ringbufwritehead][i] = ((*value * (1.0f / 4) + *(value - 1) * (1.0f / 8) + *(value + 1) * (1.0f / 8) + *(value + 8) * (1.0f / 8) +
-				//			*(value + 7) * (1.0f / 16) + *(value + 9) * (1.0f / 16)) * 6.8947572932f) * 4.0f / 3; // top wall sans corners
-				//	}
-				//	else if (i % 8 == 0) {
-				//		this->ringbuf[ringbufwritehead][i] = ((*value * (1.0f / 4) + *(value + 1) * (1.0f / 8) + *(value - 8) * (1.0f / 8) + *(value + 8) * (1.0f / 8) +
-				//			*(value + 9) * (1.0f / 16) + *(value - 7) * (1.0f / 16)) * 6.8947572932f) * 4.0f / 3; // left wall sans corners
-				//	}
-				//	else if (i % 8 == 7) {
-				//		this->ringbuf[ringbufwritehead][i] = ((*value * (1.0f / 4) + *(value - 1) * (1.0f / 8) + *(value - 8) * (1.0f / 8) + *(value + 8) * (1.0f / 8) +
-				//			*(value - 9) * (1.0f / 16) + *(value + 7) * (1.0f / 16)) * 6.8947572932f) * 4.0f / 3; // right wall sans corners
-				//	}
-				//	else if (i > 119) {
-				//		this->ringbuf[ringbufwritehead][i] = ((*value * (1.0f / 4) + *(value - 1) * (1.0f / 8) + *(value + 1) * (1.0f / 8) + *(value - 8) * (1.0f / 8) +
-				//			*(value - 7) * (1.0f / 16) + *(value - 9) * (1.0f / 16)) * 6.8947572932f) * 4.0f / 3; // bottom wall sans corners
-				//	}
-				//	else {
-				//		this->ringbuf[ringbufwritehead][i] = ((*value * (1.0f / 4) + *(value - 1) * (1.0f / 8) + *(value + 1) * (1.0f / 8) + *(value - 8) * (1.0f / 8) + *(value + 8) * (1.0f / 8) +
-				//			*(value - 7) * (1.0f / 16) + *(value - 9) * (1.0f / 16) + *(value + 7) * (1.0f / 16) + *(value + 9) * (1.0f / 16)) * 6.8947572932f); // middle pads
-				//	}
-				//	// 6.8947572932 is the conversion factor, 1 psi = 6.8947572932 kPa
-				//	// ringbuf therefore stores in kPa
-				//}
-				//ringbufwritehead = (ringbufwritehead + 1) % FORCEBUFLEN;
-				
-			}
-			else {
-				printf("recvfrom() failed with error code : %d", WSAGetLastError());
-				exit(EXIT_FAILURE);
-			}
-		}
-	}
-
-	void TactilusUDP::update() {
-		this->t->scan();
-		float* value = t->matrix();
-		for (unsigned int i = 0; i < 128; ++i, ++value) // Gaussian smoothing implementation
-		{
-
-			if (i == 0) {
-				this->ringbuf[ringbufwritehead][i] = ((*value * (1.0f / 4) + *(value + 1) * (1.0f / 8) + *(value + 8) * (1.0f / 8) + *(value + 9) * (1.0f / 16)) * 6.8947572932f) * 16.0f / 9; // top left corner case
-			}
-			else if (i == 7) {
-				this->ringbuf[ringbufwritehead][i] = ((*value * (1.0f / 4) + *(value - 1) * (1.0f / 8) + *(value + 8) * (1.0f / 8) + *(value + 7) * (1.0f / 16)) * 6.8947572932f) * 16.0f / 9; // top right corner case
-			}
-			else if (i == 120) {
-				this->ringbuf[ringbufwritehead][i] = ((*value * (1.0f / 4) + *(value + 1) * (1.0f / 8) + *(value - 8) * (1.0f / 8) + *(value - 7) * (1.0f / 16)) * 6.8947572932f) * 16.0f / 9; // bottom left corner case
-			}
-			else if (i == 127) {
-				this->ringbuf[ringbufwritehead][i] = ((*value * (1.0f / 4) + *(value - 1) * (1.0f / 8) + *(value - 8) * (1.0f / 8) + *(value - 9) * (1.0f / 16)) * 6.8947572932f) * 16.0f / 9; // bottom right corner case
-			}
-			else if (i < 8) {
-				this->ringbuf[ringbufwritehead][i] = ((*value * (1.0f / 4) + *(value - 1) * (1.0f / 8) + *(value + 1) * (1.0f / 8) + *(value + 8) * (1.0f / 8) +
-					*(value + 7) * (1.0f / 16) + *(value + 9) * (1.0f / 16)) * 6.8947572932f) * 4.0f / 3; // top wall sans corners
-			}
-			else if (i % 8 == 0) {
-				this->ringbuf[ringbufwritehead][i] = ((*value * (1.0f / 4) + *(value + 1) * (1.0f / 8) + *(value - 8) * (1.0f / 8) + *(value + 8) * (1.0f / 8) +
-					*(value + 9) * (1.0f / 16) + *(value - 7) * (1.0f / 16)) * 6.8947572932f) * 4.0f / 3; // left wall sans corners
-			}
-			else if (i % 8 == 7) {
-				this->ringbuf[ringbufwritehead][i] = ((*value * (1.0f / 4) + *(value - 1) * (1.0f / 8) + *(value - 8) * (1.0f / 8) + *(value + 8) * (1.0f / 8) +
-					*(value - 9) * (1.0f / 16) + *(value + 7) * (1.0f / 16)) * 6.8947572932f) * 4.0f / 3; // right wall sans corners
-			}
-			else if (i > 119) {
-				this->ringbuf[ringbufwritehead][i] = ((*value * (1.0f / 4) + *(value - 1) * (1.0f / 8) + *(value + 1) * (1.0f / 8) + *(value - 8) * (1.0f / 8) +
-					*(value - 7) * (1.0f / 16) + *(value - 9) * (1.0f / 16)) * 6.8947572932f) * 4.0f / 3; // bottom wall sans corners
-			}
-			else {
-				this->ringbuf[ringbufwritehead][i] = ((*value * (1.0f / 4) + *(value - 1) * (1.0f / 8) + *(value + 1) * (1.0f / 8) + *(value - 8) * (1.0f / 8) + *(value + 8) * (1.0f / 8) +
-					*(value - 7) * (1.0f / 16) + *(value - 9) * (1.0f / 16) + *(value + 7) * (1.0f / 16) + *(value + 9) * (1.0f / 16)) * 6.8947572932f); // middle pads
-			}
-			// 6.8947572932 is the conversion factor, 1 psi = 6.8947572932 kPa
-			// ringbuf therefore stores in kPa
-		}
-		ringbufwritehead = (ringbufwritehead + 1) % FORCEBUFLEN;
-	}
-
-	char* TactilusUDP::getbuf()
-		//	Returns pointer to first index of buffer of message received
-	{
-		return buf;
-	}
-
-	float* TactilusUDP::getpresbuftosend()
-		//  Returns presbuftosend
-	{
-		return presbuftosend;
-	}
-
-	void TactilusUDP::updatepresbuftosend()
-		//  Update presbuftosend
-	{
-		int head = 0;
-		float avgcurrkPa = 0;
-
-		for (unsigned int r = 0; r < this->rows; ++r)
-		{
-			for (unsigned int c = 0; c < this->cols; ++c, ++head)
-			{
-				for (unsigned int i = 0; i < FORCEBUFLEN; ++i)
-				{
-					avgcurrkPa = avgcurrkPa + ringbuf[(ringbufwritehead - 1 + i) % FORCEBUFLEN][head];
-				}
-				presbuftosend[head] = avgcurrkPa / FORCEBUFLEN; // to take the avg
-				avgcurrkPa = 0;
-			}
-		}
-	}
-
-	std::string TactilusUDP::allpressurepads()
-		//	Return string with all pressure readings in an array in [x,y] = P format; Units of kPa
-	{
-		char msg[BUFLEN];
-		std::string concatstr = "";
-		int head = 0;
-		float avgcurrkPa = 0;
-
-		for (unsigned int r = 0; r < this->rows; ++r)
-		{
-			for (unsigned int c = 0; c < this->cols; ++c, ++head)
-			{
-				for (unsigned int i = 0; i < FORCEBUFLEN; ++i)
-				{
-					avgcurrkPa = avgcurrkPa + ringbuf[(ringbufwritehead - 1 + i) % FORCEBUFLEN][head];
-				}
-				avgcurrkPa = avgcurrkPa / FORCEBUFLEN; // to take the avg
-				if (snprintf(msg, sizeof(msg), "[%d,%d] = %f \n", c, r, avgcurrkPa) < 0)
-				{
-					throw ERROR_DS_ENCODING_ERROR;
-				}
-				concatstr.append(msg);
-				avgcurrkPa = 0;
-			}
-		}
-		return concatstr;
-	}
-
-	double TactilusUDP::estimateForce()
-		//  Estimate force by multiplying areas with pressure, in N
-	{
-		double force = 0;
-		int head = 0;
-		float avgcurrkPa = 0;
-
-		for (unsigned int r = 0; r < this->rows; ++r)
-		{
-			for (unsigned int c = 0; c < this->cols; ++c, ++head)
-			{
-				for (unsigned int i = 0; i < FORCEBUFLEN; ++i)
-				{
-					// ringbuf stores kPa
-					avgcurrkPa = avgcurrkPa + ringbuf[(ringbufwritehead - 1 + i) % FORCEBUFLEN][head];
-				}
-				avgcurrkPa = avgcurrkPa / FORCEBUFLEN; // to take the avg
-				//           Divide by 1e6 to get m^2   Multiply by 1000 to get Pa
-				force = force + (this->areas[r][c] / 1e6) * ((double) avgcurrkPa * 1000);
-				// Force will be in Newtons
-				avgcurrkPa = 0;
-			}
-		}
-		return force;
-	}
-
-	double* TactilusUDP::estimateCoP()
-		//  Estimate location of center of pressure, in mm
-		//  x or p[0] should go from back to front of foot.
-		//  y or p[1] should go from inside to outside of foot [will be anti-parallel from left foot to right foot].
-	{
-		double force = 0;
-		int head = 0;
-		float avgcurrkPa = 0;
-		double force_per_mm_rows[16] = { 0 };
-		double force_per_mm_cols[8] = { 0 };
-		static double p[2] = { 0 };
-		p[0] = 0;
-		p[1] = 0;
-		for (unsigned int r = 0; r < this->rows; ++r)
-		{
-			for (unsigned int c = 0; c < this->cols; ++c, ++head)
-			{
-				for (unsigned int i = 0; i < FORCEBUFLEN; ++i)
-				{
-					// ringbuf stores kPa
-					avgcurrkPa = avgcurrkPa + ringbuf[(ringbufwritehead - 1 + i) % FORCEBUFLEN][head];
-				}
-				avgcurrkPa = avgcurrkPa / FORCEBUFLEN; // to take the avg
-				//           Divide by 1e6 to get m^2   Multiply by 1000 to get Pa
-				force = force + (this->areas[r][c] / 1e6) * ((double) avgcurrkPa * 1000);
-				// Force will be in Newtons
-
-				// We want to get force per mm_rows to help in the numreator in the CoP calculation
-				force_per_mm_rows[r] = force_per_mm_rows[r] + this->areas[r][c] / 17.2 * avgcurrkPa / 1000;
-				force_per_mm_cols[c] = force_per_mm_cols[c] + this->areas[r][c] / 9.0 * avgcurrkPa / 1000;
-				avgcurrkPa = 0;
-			}
-		}
-		for (unsigned int r = 0; r < this->rows; ++r)
-		{
-			p[0] = p[0] + force_per_mm_rows[r] * 17.2 * (270 - (r * 17.2 + 17.2 / 2.0)); // (r * 17.2 + 17.2/2.0) are the -x center locations of pads
-		}
-		p[0] = p[0] / force;
-		for (unsigned int c = 0; c < this->cols; ++c)
-		{
-			p[1] = p[1] + force_per_mm_cols[c] * 9.0 * (100 - (c * 9.0 + 9.0 / 2.0)); // (c * 9.0 + 9.0/2.0) are the -y center locations of pads
-		}
-		p[1] = p[1] / force;
-
-		return p;
-	}
-
-	double TactilusUDP::estimateMoment_y(double x1)
-		//  Estimate value of moment at specified location x1: x_max should be 270mm. 
-		//  x should go from back of foot to front of foot
-		//  Returns in Nm
-	{
-		double force = 0;
-		int head = 0;
-		float avgcurrkPa = 0;
-		double force_per_mm_rows[16] = { 0 };
-		double force_per_mm_cols[8] = { 0 };
-		double x0 = { 0 };
-		for (unsigned int r = 0; r < this->rows; ++r)
-		{
-			for (unsigned int c = 0; c < this->cols; ++c, ++head)
-			{
-				for (unsigned int i = 0; i < FORCEBUFLEN; ++i)
-				{
-					// ringbuf stores kPa
-					avgcurrkPa = avgcurrkPa + ringbuf[(ringbufwritehead - 1 + i) % FORCEBUFLEN][head];
-				}
-				avgcurrkPa = avgcurrkPa / FORCEBUFLEN; // to take the avg
-				//           Divide by 1e6 to get m^2   Multiply by 1000 to get Pa
-				force = force + (this->areas[r][c] / 1e6) * ((double) avgcurrkPa * 1000);
-				// Force will be in Newtons
-
-				// We want to get force per mm_rows to help in the numreator in the CoP calculation
-				force_per_mm_rows[r] = force_per_mm_rows[r] + this->areas[r][c] / 17.2 * avgcurrkPa / 1000;
-
-				// Force will be in Newtons
-				avgcurrkPa = 0;
-			}
-		}
-		for (unsigned int r = 0; r < this->rows; ++r)
-		{
-			x0 = x0 + force_per_mm_rows[r] * 17.2 * (270 - (r * 17.2 + 17.2 / 2.0)); // (r * 17.2 + 17.2/2.0) are the -x center locations of pads
-		}
-		if (force == 0) {
-			return 0; // Likely means no pressure on sensor at all
-		}
-		x0 = x0 / force;
-
-		return -(x0 - x1)*force / 1000; // Divide by 1000 to get Nm
-	}
-
-	double* TactilusUDP::estimateForceAndMoment_y(double x1)
-		//  Estimate value of moment at specified location x1: x_max should be 270mm. 
-		//  x should go from back of foot to front of foot
-		//  Returns in N and Nm
-	{
-		static double retforceandmoment[2];
-
-		double force = 0;
-		int head = 0;
-		float avgcurrkPa = 0;
-		double force_per_mm_rows[16] = { 0 };
-		double force_per_mm_cols[8] = { 0 };
-		double x0 = { 0 };
-		for (unsigned int r = 0; r < this->rows; ++r)
-		{
-			for (unsigned int c = 0; c < this->cols; ++c, ++head)
-			{
-				for (unsigned int i = 0; i < FORCEBUFLEN; ++i)
-				{
-					// ringbuf stores kPa
-					avgcurrkPa = avgcurrkPa + ringbuf[(ringbufwritehead - 1 + i) % FORCEBUFLEN][head];
-				}
-				avgcurrkPa = avgcurrkPa / FORCEBUFLEN; // to take the avg
-				//           Divide by 1e6 to get m^2   Multiply by 1000 to get Pa
-				force = force + (this->areas[r][c] / 1e6) * ((double) avgcurrkPa * 1000);
-				// Force will be in Newtons
-
-				// We want to get force per mm_rows to help in the numreator in the CoP calculation
-				force_per_mm_rows[r] = force_per_mm_rows[r] + this->areas[r][c] / 17.2 * avgcurrkPa / 1000;
-
-				// Force will be in Newtons
-				avgcurrkPa = 0;
-			}
-		}
-		for (unsigned int r = 0; r < this->rows; ++r)
-		{
-			x0 = x0 + force_per_mm_rows[r] * 17.2 * (270 - (r * 17.2 + 17.2 / 2.0)); // (r * 17.2 + 17.2/2.0) are the -x center locations of pads
-		}
-
-		x0 = x0 / force;
-
-		retforceandmoment[0] = force;
-		if (force == 0) {
-			retforceandmoment[1] = 0; // Likely means no pressure on sensor at all
-		}
-		else {
-			retforceandmoment[1] = -(x0 - x1)*force / 1000.0; // Divide by 1000 to get Nm
-		}
-		return retforceandmoment;
-	}
-
-	double* TactilusUDP::estimateForceAndMoment_yx(double x1, double y1) {
-		//  Estimate force, value about y axis of moment at specified location x1 [x_max should be 270mm], and value about x axis of moment at specified location y1 [y_max should be 100mm]
-		//  x should go from back of foot to front of foot, y should go from inside of foot to outside of foot [will be anti-parallel from left foot to right foot]
-		//  Returns in N and Nm
-		//  NOTE: be careful of the signs of moments! They may not be consistent depending on which foot. Make sure to figure out what the signs of the moments should be further down the algorithm
-
-		static double retforceandmoment[3];
-
-		double force = 0;
-		int head = 0;
-		float avgcurrkPa = 0;
-		double force_per_mm_rows[16] = { 0 };
-		double force_per_mm_cols[8] = { 0 };
-		double x0 = { 0 };
-		double y0 = { 0 };
-		for (unsigned int r = 0; r < this->rows; ++r)
-		{
-			for (unsigned int c = 0; c < this->cols; ++c, ++head)
-			{
-				for (unsigned int i = 0; i < FORCEBUFLEN; ++i)
-				{
-					// ringbuf stores kPa, head is like c except head doesn't go to 0 after ++r (remember ringbuf is indexed by time firstly and a vector of 128 secondly)
-					avgcurrkPa = avgcurrkPa + ringbuf[(ringbufwritehead - 1 + i) % FORCEBUFLEN][head];
-				}
-				avgcurrkPa = avgcurrkPa / FORCEBUFLEN; // to take the avg
-				//           Divide by 1e6 to get m^2   Multiply by 1000 to get Pa
-				force = force + (this->areas[r][c] / 1e6) * ((double)avgcurrkPa * 1000);
-				// Force will be in Newtons
-
-				// We want to get force per mm_rows to help in the numreator in the CoP calculation
-				force_per_mm_rows[r] = force_per_mm_rows[r] + this->areas[r][c] / 17.2 * avgcurrkPa / 1000;
-				force_per_mm_cols[c] = force_per_mm_cols[c] + this->areas[r][c] / 13.0 * avgcurrkPa / 1000; 
-
-				// Force will be in Newtons
-				avgcurrkPa = 0;
-			}
-		}
-		for (unsigned int r = 0; r < this->rows; ++r)
-		{
-			x0 = x0 + force_per_mm_rows[r] * 17.2 * (270 - (r * 17.2 + 17.2 / 2.0)); // (r * 17.2 + 17.2/2.0) are the -x center locations of pads
-		}
-		for (unsigned int c = 0; c < this->cols; ++c)
-		{
-			y0 = y0 + force_per_mm_cols[c] * 13.0 * (100 - (c * 13.0 + 13.0 / 2.0)); // (c * 13.0 + 13.0/2.0) are the -y center locations of pads
-		}
-
-		x0 = x0 / force; // the all-important dividing by total force to get mm for CoP (the for loop above made x0 or y0 into total moment about y axis or x axis)
-		y0 = y0 / force;
-
-		retforceandmoment[0] = force;
-		if (force == 0) {
-			retforceandmoment[1] = 0; // Likely means no pressure on sensor at all
-			retforceandmoment[2] = 0;
-		}
-		else {
-			retforceandmoment[1] = -(x0 - x1)*force / 1000.0; // Divide by 1000 to get Nm
-			retforceandmoment[2] = (y0 - y1)*force / 1000.0;
-		}
-		return retforceandmoment;
-	}
-
-	std::vector<double> TactilusUDP::estimateForceAndMoment_yx_somepadforces(double x1, double y1, u_int* padx, u_int* pady, u_int padnumber) {
-		//  Estimate force, value about y axis of moment at specified location x1 [x_max should be 270mm], and value about x axis of moment at specified location y1 [y_max should be 100mm]
-		//  x should go from back of foot to front of foot, y should go from inside of foot to outside of foot [will be anti-parallel from left foot to right foot]
-		//  Will also return forces from requested pads, given by x coordinates in padx and y coordinates in pady
-		//  Returns in N and Nm
-		//  NOTE: be careful of the signs of moments! They may not be consistent depending on which foot. Make sure to figure out what the signs of the moments should be further down the algorithm
-
-		static std::vector<double> retforceandmoment(padnumber + 3);
-
-		double force = 0;
-		int head = 0;
-		float avgcurrkPa = 0;
-		u_int currentpad = 0;
-		double force_per_mm_rows[16] = { 0 };
-		double force_per_mm_cols[8] = { 0 };
-		double x0 = { 0 };
-		double y0 = { 0 };
-		for (unsigned int r = 0; r < this->rows; ++r)
-		{
-			for (unsigned int c = 0; c < this->cols; ++c, ++head)
-			{
-				for (unsigned int i = 0; i < FORCEBUFLEN; ++i)
-				{
-					// ringbuf stores kPa, head is like c except head doesn't go to 0 after ++r (remember ringbuf is indexed by time firstly and a vector of 128 secondly)
-					avgcurrkPa = avgcurrkPa + ringbuf[(ringbufwritehead - 1 + i) % FORCEBUFLEN][head];
-				}
-				avgcurrkPa = avgcurrkPa / FORCEBUFLEN; // to take the avg
-				//           Divide by 1e6 to get m^2   Multiply by 1000 to get Pa
-				force = force + (this->areas[r][c] / 1e6) * ((double)avgcurrkPa * 1000);
-				// Force will be in Newtons
-
-				// We want to get force per mm_rows to help in the numreator in the CoP calculation
-				force_per_mm_rows[r] = force_per_mm_rows[r] + this->areas[r][c] / 17.2 * avgcurrkPa / 1000;
-				force_per_mm_cols[c] = force_per_mm_cols[c] + this->areas[r][c] / 13.0 * avgcurrkPa / 1000;
-
-				for (u_int j = 0; j < padnumber; ++j)
-				{
-					if (r == padx[j] && c == pady[j]) {
-						retforceandmoment[3 + j] = (this->areas[padx[j]][pady[j]] / 1e6) * ((double)avgcurrkPa * 1000);
-					}
-				}
-
-				// Force will be in Newtons
-				avgcurrkPa = 0;
-			}
-		}
-		for (unsigned int r = 0; r < this->rows; ++r)
-		{
-			x0 = x0 + force_per_mm_rows[r] * 17.2 * (270 - (r * 17.2 + 17.2 / 2.0)); // (r * 17.2 + 17.2/2.0) are the -x center locations of pads
-		}
-		for (unsigned int c = 0; c < this->cols; ++c)
-		{
-			y0 = y0 + force_per_mm_cols[c] * 13.0 * (100 - (c * 13.0 + 13.0 / 2.0)); // (c * 13.0 + 13.0/2.0) are the -y center locations of pads
-		}
-
-		x0 = x0 / force; // the all-important dividing by total force to get mm for CoP (the for loop above made x0 or y0 into total moment about y axis or x axis)
-		y0 = y0 / force;
-
-		retforceandmoment[0] = force;
-		if (force == 0) {
-			retforceandmoment[1] = 0; // Likely means no pressure on sensor at all
-			retforceandmoment[2] = 0;
-		}
-		else {
-			retforceandmoment[1] = -(x0 - x1)*force / 1000.0; // Divide by 1000 to get Nm
-			retforceandmoment[2] = (y0 - y1)*force / 1000.0;
-		}
-	
-		return retforceandmoment;
-	}
-	std::vector<double> TactilusUDP::estimateForceAndMoment_yx_frontbackforces(double x1, double y1) {
-		//  Estimate force, value about y axis of moment at specified location x1 [x_max should be 270mm], and value about x axis of moment at specified location y1 [y_max should be 100mm]
-		//  x should go from back of foot to front of foot, y should go from inside of foot to outside of foot [will be anti-parallel from left foot to right foot]
-		//  Also returns force of front 64 pads and force of back 64 pads
-		//  Returns in N and Nm
-		//  NOTE: be careful of the signs of moments! They may not be consistent depending on which foot. Make sure to figure out what the signs of the moments should be further down the algorithm
-
-		static std::vector<double> retforceandmoment(5);
-		retforceandmoment[3] = 0;
-		retforceandmoment[4] = 0;
-
-		double force = 0;
-		int head = 0;
-		float avgcurrkPa = 0;
-		u_int currentpad = 0;
-		double force_per_mm_rows[16] = { 0 };
-		double force_per_mm_cols[8] = { 0 };
-		double x0 = { 0 };
-		double y0 = { 0 };
-		for (unsigned int r = 0; r < this->rows; ++r)
-		{
-			for (unsigned int c = 0; c < this->cols; ++c, ++head)
-			{
-				for (unsigned int i = 0; i < FORCEBUFLEN; ++i)
-				{
-					// ringbuf stores kPa, head is like c except head doesn't go to 0 after ++r (remember ringbuf is indexed by time firstly and a vector of 128 secondly)
-					avgcurrkPa = avgcurrkPa + ringbuf[(ringbufwritehead - 1 + i) % FORCEBUFLEN][head];
-				}
-				avgcurrkPa = avgcurrkPa / FORCEBUFLEN; // to take the avg
-				//           Divide by 1e6 to get m^2   Multiply by 1000 to get Pa
-				force = force + (this->areas[r][c] / 1e6) * ((double)avgcurrkPa * 1000);
-				// Force will be in Newtons
-
-				// We want to get force per mm_rows to help in the numreator in the CoP calculation
-				force_per_mm_rows[r] = force_per_mm_rows[r] + this->areas[r][c] / 17.2 * avgcurrkPa / 1000;
-				force_per_mm_cols[c] = force_per_mm_cols[c] + this->areas[r][c] / 13.0 * avgcurrkPa / 1000;
-
-				if (r < 8) {
-					retforceandmoment[3] = retforceandmoment[3] + (this->areas[r][c] / 1e6) * ((double)avgcurrkPa * 1000);
-				}
-				else {
-					retforceandmoment[4] = retforceandmoment[4] + (this->areas[r][c] / 1e6) * ((double)avgcurrkPa * 1000);
-				}
-
-				// Force will be in Newtons
-				avgcurrkPa = 0;
-			}
-		}
-		for (unsigned int r = 0; r < this->rows; ++r)
-		{
-			x0 = x0 + force_per_mm_rows[r] * 17.2 * (270 - (r * 17.2 + 17.2 / 2.0)); // (r * 17.2 + 17.2/2.0) are the -x center locations of pads
-		}
-		for (unsigned int c = 0; c < this->cols; ++c)
-		{
-			y0 = y0 + force_per_mm_cols[c] * 13.0 * (100 - (c * 13.0 + 13.0 / 2.0)); // (c * 13.0 + 13.0/2.0) are the -y center locations of pads
-		}
-
-		x0 = x0 / force; // the all-important dividing by total force to get mm for CoP (the for loop above made x0 or y0 into total moment about y axis or x axis)
-		y0 = y0 / force;
-
-		retforceandmoment[0] = force;
-		if (force == 0) {
-			retforceandmoment[1] = 0; // Likely means no pressure on sensor at all
-			retforceandmoment[2] = 0;
-		}
-		else {
-			retforceandmoment[1] = -(x0 - x1) * force / 1000.0; // Divide by 1000 to get Nm
-			retforceandmoment[2] = (y0 - y1) * force / 1000.0;
-		}
-
-		return retforceandmoment;
-	}
-}
-
-std::string msg;
-char* recvmsg;
-int recvmsglen;
 double desiredmomentx;
 double desiredmomenty;
-double* cop;
-double* forcemoment;
-u_int padnumbersize = 2;
-std::vector<double> forcemomentvec(2+padnumbersize);
-double force, momentx, momenty;
-float presbuftosend1[128], presbuftosend2[128];
-std::mutex presbuftosendX_mutex;
 u_int numsensreq; //number of sensors requested by BBB at beginning of main
-u_int padx_des[2] = { 13, 2 };
-u_int pady_des[2] = { 2, 4 };
-double pad1force, pad2force;
+tactilus_udp::KineticsRequest kineticsreq; // what updateandsend asks of each sensor, filled in from the handshake
+std::vector<tactilus_udp::KineticsRequest> sensorreqs; // kineticsreq plus what the handshake asked of one sensor only
+uint32_t sendfields = tactilus_udp::DEFAULTFIELDS; // which PacketField quantities go out for each sensor
+double sendrate = 0; // most packets a second the receiver wants, 0 for as fast as the sensors scan
+bool sendmap = false; // whether packets carry every sensor's pressure map
+u_int mapkeyinterval = MAPKEYINTERVAL; // packets between map keyframes, 1 for no deltas
+float mapfloorkPa = 0; // pads below this go out in the maps as 0
+u_int statsport = 0; // port of the receiver the stage timings also go to as text, 0 for just printing them
+u_int heartbeatms = 0; // how often the receiver said it sends heartbeats, 0 if it doesn't
 
 // Note, in the reference frame, we define x as along the columns and y as along the rows
 		// the origin is in the top left. x increases as we go up, y increases as we go left, which
@@ -817,58 +105,25 @@ std::string sa_allpressurepads(float* presbuftosendX)
 double sa_estimateForce(float* presbuftosendX)
 //  Estimate force by multiplying areas with pressure, in N
 {
-	double force = 0;
-	int head = 0;
-
-	for (unsigned int r = 0; r < 16; ++r)
-	{
-		for (unsigned int c = 0; c < 8; ++c, ++head)
-		{
-			//           Divide by 1e6 to get m^2   Multiply by 1000 to get Pa
-			force = force + (areas[r][c] / 1e6) * ((double) presbuftosendX[head] * 1000);
-			// Force will be in Newtons
-		}
-	}
-	return force;
+	tactilus_udp::KineticsRequest req;
+	tactilus_udp::KineticsResult res;
+	tactilus_udp::computeKinetics(presbuftosendX, areas, req, res);
+	return res.force;
 }
 
-double* sa_estimateCoP(float* presbuftosendX)
-//  Estimate location of center of pressure, in mm
+void sa_estimateCoP(float* presbuftosendX, double* p)
+//  Estimate location of center of pressure into p[0..1], in mm
 //  x or p[0] should go from back to front of foot.
 //  y or p[1] should go from inside to outside of foot [will be anti-parallel from left foot to right foot].
 {
-	double force = 0;
-	int head = 0;
-	double force_per_mm_rows[16] = { 0 };
-	double force_per_mm_cols[8] = { 0 };
-	static double p[2] = { 0 };
-	p[0] = 0;
+	tactilus_udp::KineticsRequest req;
+	tactilus_udp::KineticsResult res;
+	tactilus_udp::computeKinetics(presbuftosendX, areas, req, res);
+	p[0] = res.copx;
 	p[1] = 0;
-	for (unsigned int r = 0; r < 16; ++r)
-	{
-		for (unsigned int c = 0; c < 8; ++c, ++head)
-		{
-			//           Divide by 1e6 to get m^2   Multiply by 1000 to get Pa
-			force = force + (areas[r][c] / 1e6) * ((double) presbuftosendX[head] * 1000);
-			// Force will be in Newtons
-
-			// We want to get force per mm_rows to help in the numreator in the CoP calculation
-			force_per_mm_rows[r] = force_per_mm_rows[r] + areas[r][c] / 17.2 * presbuftosendX[head] / 1000;
-			force_per_mm_cols[c] = force_per_mm_cols[c] + areas[r][c] / 9.0 * presbuftosendX[head] / 1000;
-		}
-	}
-	for (unsigned int r = 0; r < 16; ++r)
-	{
-		p[0] = p[0] + force_per_mm_rows[r] * 17.2 * (270 - (r * 17.2 + 17.2 / 2.0)); // (r * 17.2 + 17.2/2.0) are the -x center locations of pads
+	if (res.force != 0) {
+		p[1] = 100 - 9.0 * (res.sumfc / res.force + 0.5); // CoP has always used (c * 9.0 + 9.0/2.0) as the -y center locations of pads
 	}
-	p[0] = p[0] / force;
-	for (unsigned int c = 0; c < 8; ++c)
-	{
-		p[1] = p[1] + force_per_mm_cols[c] * 9.0 * (100 - (c * 9.0 + 9.0 / 2.0)); // (c * 9.0 + 9.0/2.0) are the -y center locations of pads
-	}
-	p[1] = p[1] / force;
-
-	return p;
 }
 
 double sa_estimateMoment_y(float* presbuftosendX, double x1)
@@ -876,233 +131,388 @@ double sa_estimateMoment_y(float* presbuftosendX, double x1)
 //  x should go from back of foot to front of foot
 //  Returns in Nm
 {
-	double force = 0;
-	int head = 0;
-	double force_per_mm_rows[16] = { 0 };
-	double force_per_mm_cols[8] = { 0 };
-	double x0 = { 0 };
-	for (unsigned int r = 0; r < 16; ++r)
-	{
-		for (unsigned int c = 0; c < 8; ++c, ++head)
-		{
-			//           Divide by 1e6 to get m^2   Multiply by 1000 to get Pa
-			force = force + (areas[r][c] / 1e6) * ((double)presbuftosendX[head] * 1000);
-			// Force will be in Newtons
-
-			// We want to get force per mm_rows to help in the numreator in the CoP calculation
-			force_per_mm_rows[r] = force_per_mm_rows[r] + areas[r][c] / 17.2 * presbuftosendX[head] / 1000;
-
-			// Force will be in Newtons
-			presbuftosendX[head] = 0;
-		}
-	}
-	for (unsigned int r = 0; r < 16; ++r)
-	{
-		x0 = x0 + force_per_mm_rows[r] * 17.2 * (270 - (r * 17.2 + 17.2 / 2.0)); // (r * 17.2 + 17.2/2.0) are the -x center locations of pads
-	}
-	if (force == 0) {
-		return 0; // Likely means no pressure on sensor at all
-	}
-	x0 = x0 / force;
-
-	return -(x0 - x1)*force / 1000; // Divide by 1000 to get Nm
+	tactilus_udp::KineticsRequest req;
+	tactilus_udp::KineticsResult res;
+	req.x1 = x1;
+	tactilus_udp::computeKinetics(presbuftosendX, areas, req, res);
+	return res.momenty;
 }
 
-double* sa_estimateForceAndMoment_y(float* presbuftosendX, double x1)
+void sa_estimateForceAndMoment_y(float* presbuftosendX, double x1, double* forceandmoment)
 //  Estimate value of moment at specified location x1: x_max should be 270mm. 
 //  x should go from back of foot to front of foot
-//  Returns in N and Nm
+//  Returns in N and Nm in forceandmoment[0..1]
 {
-	static double retforceandmoment[2];
-
-	double force = 0;
-	int head = 0;
-	double force_per_mm_rows[16] = { 0 };
-	double force_per_mm_cols[8] = { 0 };
-	double x0 = { 0 };
-	for (unsigned int r = 0; r < 16; ++r)
-	{
-		for (unsigned int c = 0; c < 8; ++c, ++head)
-		{
-			//           Divide by 1e6 to get m^2   Multiply by 1000 to get Pa
-			force = force + (areas[r][c] / 1e6) * ((double)presbuftosendX[head] * 1000);
-			// Force will be in Newtons
- 
-			force_per_mm_rows[r] = force_per_mm_rows[r] + areas[r][c] / 17.2 * presbuftosendX[head] / 1000;
-
-		}
-	}
-	for (unsigned int r = 0; r < 16; ++r)
-	{
-		x0 = x0 + force_per_mm_rows[r] * 17.2 * (270 - (r * 17.2 + 17.2 / 2.0)); // (r * 17.2 + 17.2/2.0) are the -x center locations of pads
-	}
-
-	x0 = x0 / force;
-
-	retforceandmoment[0] = force;
-	if (force == 0) {
-		retforceandmoment[1] = 0; // Likely means no pressure on sensor at all
-	}
-	else {
-		retforceandmoment[1] = -(x0 - x1)*force / 1000.0; // Divide by 1000 to get Nm
-	}
-	return retforceandmoment;
+	tactilus_udp::KineticsRequest req;
+	tactilus_udp::KineticsResult res;
+	req.x1 = x1;
+	tactilus_udp::computeKinetics(presbuftosendX, areas, req, res);
+	forceandmoment[0] = res.force;
+	forceandmoment[1] = res.momenty;
 }
 
-double* sa_estimateForceAndMoment_yx(float* presbuftosendX, double x1, double y1) {
+void sa_estimateForceAndMoment_yx(float* presbuftosendX, double x1, double y1, double* forceandmoment) {
 	//  Estimate force, value about y axis of moment at specified location x1 [x_max should be 270mm], and value about x axis of moment at specified location y1 [y_max should be 100mm]
 	//  x should go from back of foot to front of foot, y should go from inside of foot to outside of foot [will be anti-parallel from left foot to right foot]
-	//  Returns in N and Nm
+	//  Returns in N and Nm in forceandmoment[0..2]
 	//  NOTE: be careful of the signs of moments! They may not be consistent depending on which foot. Make sure to figure out what the signs of the moments should be further down the algorithm
 
-	static double retforceandmoment[3];
+	tactilus_udp::KineticsRequest req;
+	tactilus_udp::KineticsResult res;
+	req.x1 = x1;
+	req.y1 = y1;
+	tactilus_udp::computeKinetics(presbuftosendX, areas, req, res);
+	forceandmoment[0] = res.force;
+	forceandmoment[1] = res.momenty;
+	forceandmoment[2] = res.momentx;
+}
 
-	double force = 0;
-	int head = 0;
-	double force_per_mm_rows[16] = { 0 };
-	double force_per_mm_cols[8] = { 0 };
-	double x0 = { 0 };
-	double y0 = { 0 };
-	for (unsigned int r = 0; r < 16; ++r)
+std::string updateandsend(std::vector<tactilus_udp::TactilusUDP*>& tacts, const std::string& reply)
+	//  tacts[0] is the communicator, every packet carries one set of sendfields per sensor in tacts order
+	//  Streams until the receiver asks for something else, returning its new reply, or goes quiet or asks for a rehandshake, returning ""
+{
+	// Everything the loop needs is set up here, in steady state sending a packet doesn't allocate
+	tactilus_udp::Sender sender(tacts, sensorreqs, sendfields);
+	sender.setrate(sendrate);
+	sender.setmap(sendmap, mapkeyinterval, mapfloorkPa);
+	sender.start();
+	std::chrono::steady_clock::time_point lastheard = std::chrono::steady_clock::now(); // last heartbeat, or the reply
+	std::chrono::steady_clock::time_point nextcontrol = lastheard;
+	for (unsigned long packets = 1; ; ++packets)
 	{
-		for (unsigned int c = 0; c < 8; ++c, ++head)
-		{
-			//           Divide by 1e6 to get m^2   Multiply by 1000 to get Pa
-			force = force + (areas[r][c] / 1e6) * ((double)presbuftosendX[head] * 1000);
-			// Force will be in Newtons
+		sender.sendnext();
+
+		// The receiver's control messages, a few times per heartbeat so one recv() in 100 packets or so
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now >= nextcontrol) {
+			nextcontrol = now + std::chrono::milliseconds(heartbeatms > 0 ? heartbeatms / 4 + 1 : HANDSHAKERETRYMS / 4);
+			int len;
+			while ((len = tacts[0]->recv()) > 0)
+			{
+				const char* msg = tacts[0]->getbuf();
+				if (!tacts[0]->fromdestination()) {
+					continue; // e.g. a subscriber's receiver that wants a handshake it can't have
+				}
+				if (tactilus_udp::isControl(msg, len, HEARTBEATMSG)) {
+					lastheard = now;
+				}
+				else if (tactilus_udp::isControl(msg, len, REHANDSHAKEMSG)) {
+					printf("The receiver asked for another handshake.\n");
+					return "";
+				}
+				else if (tactilus_udp::isHandshakeReply(msg, len)) {
+					if (reply.compare(0, std::string::npos, msg, len) != 0) {
+						printf("The receiver asked for something else.\n");
+						return std::string(msg, len);
+					}
+					lastheard = now; // the same reply again, the answer to a handshake that was retransmitted
+				}
+			}
+			if (heartbeatms > 0 && now - lastheard > std::chrono::milliseconds(heartbeatms * HEARTBEATMISSES)) {
+				printf("No heartbeat from the receiver for %u ms, handshaking again.\n", heartbeatms * HEARTBEATMISSES);
+				return "";
+			}
+		}
 
-			force_per_mm_rows[r] = force_per_mm_rows[r] + areas[r][c] / 17.2 * presbuftosendX[head] / 1000;
-			force_per_mm_cols[c] = force_per_mm_cols[c] + areas[r][c] / 13.0 * presbuftosendX[head] / 1000;
+		if (packets % STATSPACKETS == 0) {
+			// How the pipeline stages kept up
+			tactilus_udp::SenderStats stats = sender.getstats();
+			printf("Packets %lu sent %lu, frames skipped %lu, encode failed %lu, transmit queue full %lu, depth", stats.packets, stats.sent, stats.skippedframes, stats.encodefailed, stats.queuefull);
+			for (u_int i = 0; i <= SENDQUEUELEN; ++i) {
+				printf(" %lu", stats.queuedepth[i]);
+			}
+			printf("\n");
+			for (u_int i = 1; i < tacts[0]->getsubscribercount(); ++i)
+			{
+				const tactilus_udp::Subscriber& sub = tacts[0]->getsubscriber(i);
+				printf("Subscriber %s:%u sent %lu failed %lu\n", inet_ntoa(sub.addr.sin_addr), ntohs(sub.addr.sin_port), sub.sent.load(), sub.failed.load());
+			}
 
+			// How long each stage took over the last STATSPACKETS packets
+			char timing[512];
+			int timinglen = sender.gettiming().format(timing, sizeof(timing));
+			if (timinglen > 0 && timinglen < (int)sizeof(timing)) {
+				printf("%s\n", timing);
+				if (statsport != 0) {
+					tacts[0]->send(timing, timinglen, statsport);
+				}
+			}
+			sender.gettiming().reset();
 		}
 	}
-	for (unsigned int r = 0; r < 16; ++r)
-	{
-		x0 = x0 + force_per_mm_rows[r] * 17.2 * (270 - (r * 17.2 + 17.2 / 2.0)); // (r * 17.2 + 17.2/2.0) are the -x center locations of pads
-	}
-	for (unsigned int c = 0; c < 8; ++c)
-	{
-		y0 = y0 + force_per_mm_cols[c] * 13.0 * (100 - (c * 13.0 + 13.0 / 2.0)); // (c * 13.0 + 13.0/2.0) are the -y center locations of pads
-	}
+}
 
-	x0 = x0 / force; // the all-important dividing by total force to get mm for CoP (the for loop above made x0 or y0 into total moment about y axis or x axis)
-	y0 = y0 / force;
+bool synthetic; // walk SyntheticGaitSources instead of opening insoles
+const char* server = SERVER;
 
-	retforceandmoment[0] = force;
-	if (force == 0) {
-		retforceandmoment[1] = 0; // Likely means no pressure on sensor at all
-		retforceandmoment[2] = 0;
-	}
-	else {
-		retforceandmoment[1] = -(x0 - x1)*force / 1000.0; // Divide by 1000 to get Nm
-		retforceandmoment[2] = (y0 - y1)*force / 1000.0;
-	}
-	return retforceandmoment;
+tactilus_udp::TactilusUDP* opensensor(u_int index, u_int communicator)
+	//  Opens sensor number index, the next insole the driver has registered or a synthetic foot
+{
+#ifdef _WIN32
+	if (!synthetic) {
+		return new tactilus_udp::TactilusUDP(server, SRCPORT, DSTPORT, communicator);
+	}
+#endif
+	tactilus_udp::GaitParams gait;
+	gait.seed = index + 1;
+	gait.phase = 0.5 * index; // left and right feet take turns
+	return new tactilus_udp::TactilusUDP(new tactilus_udp::SyntheticGaitSource(gait), server, SRCPORT, DSTPORT, communicator);
 }
 
-unsigned long send_counter;
-u_int rel_send_counter;
-
-void updateandsend(tactilus_udp::TactilusUDP& tact1, tactilus_udp::TactilusUDP& tact2, float* presbuftosend1, float* presbuftosend2)
+std::string handshake(tactilus_udp::TactilusUDP* tact)
+	//  Sends a handshake every HANDSHAKERETRYMS until the receiver replies, sleeping on the socket in between, and returns the reply
 {
-	while (1)
+	printf("Handshaking with %s.\n", server);
+	for (;;)
 	{
-		if (tact1.gettactilusid() != tact2.gettactilusid()) {
-			std::thread x(&tactilus_udp::TactilusUDP::update, &tact1);
-			std::thread y(&tactilus_udp::TactilusUDP::update, &tact2);
-			x.join();
-			y.join();
-		}
-		else {
-			tact1.update();
-		}
-
-		forcemomentvec = tact1.estimateForceAndMoment_yx_frontbackforces(desiredmomentx, desiredmomenty);
-		force = forcemomentvec[0];
-		momenty = forcemomentvec[1];
-		momentx = forcemomentvec[2];
-		pad1force = forcemomentvec[3];
-		pad2force = forcemomentvec[4];
-		msg = std::to_string(force);
-		msg.append(",");
-		msg.append(std::to_string(momenty));
-		msg.append(",");
-		msg.append(std::to_string(momentx));
-		msg.append(",");
-		msg.append(std::to_string(pad1force));
-		msg.append(",");
-		msg.append(std::to_string(pad2force));
-
-		if (tact1.gettactilusid() != tact2.gettactilusid()) {
-			forcemomentvec = tact2.estimateForceAndMoment_yx_frontbackforces(desiredmomentx, desiredmomenty);
-			force = forcemomentvec[0];
-			momenty = forcemomentvec[1];
-			momentx = forcemomentvec[2];
-			pad1force = forcemomentvec[3];
-			pad2force = forcemomentvec[4];
-			msg.append(",");
-			msg.append(std::to_string(force));
-			msg.append(",");
-			msg.append(std::to_string(momenty));
-			msg.append(",");
-			msg.append(std::to_string(momentx));
-			msg.append(",");
-			msg.append(std::to_string(pad1force));
-			msg.append(",");
-			msg.append(std::to_string(pad2force));
+		tact->send(HANDSHAKEMSG);
+		std::chrono::steady_clock::time_point retry = std::chrono::steady_clock::now() + std::chrono::milliseconds(HANDSHAKERETRYMS);
+		for (std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now(); now < retry; now = std::chrono::steady_clock::now())
+		{
+			int len = tact->recv((u_int)std::chrono::duration_cast<std::chrono::milliseconds>(retry - now).count() + 1);
+			if (tactilus_udp::isHandshakeReply(tact->getbuf(), len)) {
+				printf("Handshake received.\n");
+				return std::string(tact->getbuf(), len);
+			}
 		}
-
-		tact1.send(msg);
 	}
 }
 
-int main(void)
+bool configure(const std::string& reply, std::vector<tactilus_udp::TactilusUDP*>& opened, std::vector<tactilus_udp::TactilusUDP*>& tacts)
+	//  Sets everything up the way a handshake reply "x,y,N[,key=value...]" asks, starting from the defaults whatever an earlier reply asked
+	//  Opens more sensors if opened has fewer than N, tacts become the first N. Returns false if the reply can't be served
 {
-	tactilus_udp::TactilusUDP *tact1;
-	tact1 = new tactilus_udp::TactilusUDP(SERVER, SRCPORT, DSTPORT, 1);
-	
-	tact1->send("handshake");
-	printf("Handshake sent.\n");
-	while (recvmsglen == 0) {
-		tact1->recv();
-		recvmsg = tact1->getbuf();
-		recvmsglen = strlen(recvmsg);
-	}
-
-	std::string recvmsgstr(recvmsg, recvmsg + recvmsglen);
 	std::string temp;
 
-	// the following is used to break up recvmsgstr string to a vector of strings
-	std::stringstream ss(recvmsgstr);
+	// the following is used to break up the reply to a vector of strings
+	std::stringstream ss(reply);
 	std::vector<std::string> words;
 
 	while (getline(ss, temp, ',')) {
 		words.push_back(temp);
 	}
 
-	desiredmomentx = std::stod(words[0]);
-	desiredmomenty = std::stod(words[1]);
+	desiredmomentx = strtod(words[0].c_str(), NULL);
+	desiredmomenty = words.size() > 1 ? strtod(words[1].c_str(), NULL) : 0;
+	kineticsreq = tactilus_udp::KineticsRequest();
+	kineticsreq.x1 = desiredmomentx;
+	kineticsreq.y1 = desiredmomenty;
+	sendfields = tactilus_udp::DEFAULTFIELDS;
+	sendrate = 0;
+	sendmap = false;
+	mapkeyinterval = MAPKEYINTERVAL;
+	mapfloorkPa = 0;
+	statsport = 0;
+	heartbeatms = 0;
+
+	// The receiver asks for any number of sensors, up to what one packet can carry
+	numsensreq = words.size() > 2 ? (u_int)strtoul(words[2].c_str(), NULL, 10) : 0;
+	if (numsensreq < 1 || numsensreq > MAXSENSORS)
+	{
+		printf("Can't open %s sensors, between 1 and %d can be requested.\n", words.size() > 2 ? words[2].c_str() : "no", MAXSENSORS);
+		return false;
+	}
+
+	// Every new Tactilus object connects to the next insole the driver has registered, so opening
+	// them one after another finds all of them. opened[0] is already open and does the talking.
+	while (opened.size() < numsensreq)
+	{
+		opened.push_back(opensensor((u_int)opened.size(), 0));
+	}
+	tacts.assign(opened.begin(), opened.begin() + numsensreq);
 
-	if (words[2].compare("1") == 0)
+	// What an earlier reply asked for goes back to the defaults first
+	tactilus_udp::FilterParams boxcar;
+	boxcar.length = FORCEBUFLEN;
+	for (u_int i = 0; i < numsensreq; ++i)
 	{
-		tact1->update();
-		for (unsigned int i = 0; i < 128; ++i) {
-			presbuftosend1[i] = tact1->getpresbuftosend()[i];
-		}
-		updateandsend(*tact1, *tact1, presbuftosend1, presbuftosend2);
+		tacts[i]->setfilter(boxcar);
 	}
-	else if (words[2].compare("2") == 0)
+	tacts[0]->clearsubscribers();
+
+	// Anything after the sensor count is key=value options. A key ending in a sensor number (counting from 1) only applies to that sensor
+	sensorreqs.assign(numsensreq, kineticsreq);
+	u_int padnumber = 0; // most pads any sensor asked for
+	for (u_int w = 3; w < words.size(); ++w)
 	{
-		tactilus_udp::TactilusUDP *tact2;
-		tact2 = new tactilus_udp::TactilusUDP(SERVER, SRCPORT, DSTPORT, 0);
-		tact1->update();
-		tact2->update();
-		for (unsigned int i = 0; i < 128; ++i) {
-			presbuftosend1[i] = tact1->getpresbuftosend()[i];
-			presbuftosend2[i] = tact2->getpresbuftosend()[i];
+		std::string key = words[w].substr(0, words[w].find('='));
+		std::string value = words[w].find('=') == std::string::npos ? "" : words[w].substr(words[w].find('=') + 1);
+		if (key.compare(0, 6, "filter") == 0)
+		{
+			// filter=spec for every sensor, filterN=spec for sensor N (counting from 1), spec as in tactilus_udp::parseFilter
+			u_int sensor = key.size() > 6 ? (u_int)strtoul(key.c_str() + 6, NULL, 10) : 0;
+			tactilus_udp::FilterParams filter;
+			filter.length = FORCEBUFLEN;
+			if (!tactilus_udp::parseFilter(value, filter) || sensor > numsensreq) {
+				printf("Ignoring handshake option %s.\n", words[w].c_str());
+				continue;
+			}
+			for (u_int i = 0; i < numsensreq; ++i)
+			{
+				if (sensor == 0 || sensor == i + 1) {
+					tacts[i]->setfilter(filter);
+				}
+			}
+		}
+		else if (key == "fields")
+		{
+			// fields=force+momenty+...: just these quantities get computed and sent, names as in tactilus_udp::parseFields
+			uint32_t fields;
+			if (!tactilus_udp::parseFields(value.c_str(), fields)) {
+				printf("Ignoring handshake option %s.\n", words[w].c_str());
+				continue;
+			}
+			sendfields = fields | (sendfields & ~(tactilus_udp::FIELD_PAD0 - 1)); // keeps the pads already asked for
+		}
+		else if ((key[0] == 'x' || key[0] == 'y') && key.size() > 1 && isdigit((unsigned char)key[1]))
+		{
+			// xN=mm, yN=mm: where sensor N's moments are taken about, instead of the x,y at the start of the handshake
+			u_int sensor = (u_int)strtoul(key.c_str() + 1, NULL, 10);
+			if (sensor < 1 || sensor > numsensreq) {
+				printf("Ignoring handshake option %s.\n", words[w].c_str());
+				continue;
+			}
+			double at = strtod(value.c_str(), NULL);
+			if (key[0] == 'x') {
+				sensorreqs[sensor - 1].x1 = at;
+			}
+			else {
+				sensorreqs[sensor - 1].y1 = at;
+			}
+		}
+		else if (key.compare(0, 4, "pads") == 0)
+		{
+			// pads=row:col+row:col... for every sensor, padsN=... for sensor N: the forces of these pads are sent too, in this order
+			// Every sensor sends the same fields, as many pads as the longest list: a sensor given fewer sends 0 for the rest
+			u_int sensor = key.size() > 4 ? (u_int)strtoul(key.c_str() + 4, NULL, 10) : 0;
+			tactilus_udp::KineticsRequest pads;
+			std::stringstream padlist(value);
+			std::string pad;
+			bool valid = sensor <= numsensreq;
+			while (valid && getline(padlist, pad, '+'))
+			{
+				valid = pads.padnumber < MAXPADREQ && sscanf(pad.c_str(), "%u:%u", &pads.padx[pads.padnumber], &pads.pady[pads.padnumber]) == 2
+					&& pads.padx[pads.padnumber] < PADROWS && pads.pady[pads.padnumber] < PADCOLS;
+				++pads.padnumber;
+			}
+			if (!valid) {
+				printf("Ignoring handshake option %s.\n", words[w].c_str());
+				continue;
+			}
+			for (u_int i = 0; i < numsensreq; ++i)
+			{
+				if (sensor == 0 || sensor == i + 1) {
+					memcpy(sensorreqs[i].padx, pads.padx, sizeof(pads.padx));
+					memcpy(sensorreqs[i].pady, pads.pady, sizeof(pads.pady));
+					sensorreqs[i].padnumber = pads.padnumber;
+				}
+			}
+			padnumber = pads.padnumber > padnumber ? pads.padnumber : padnumber;
+			for (u_int j = 0; j < padnumber; ++j)
+			{
+				sendfields = sendfields | (tactilus_udp::FIELD_PAD0 << j);
+			}
+		}
+		else if (key == "map")
+		{
+			// map=delta[:keyinterval] or map=key: packets also carry the pressure maps, quantised and delta or only key encoded
+			std::string mode = value.substr(0, value.find(':'));
+			if (mode != "delta" && mode != "key") {
+				printf("Ignoring handshake option %s.\n", words[w].c_str());
+				continue;
+			}
+			sendmap = true;
+			mapkeyinterval = mode == "key" ? 1 : MAPKEYINTERVAL;
+			if (mode == "delta" && value.find(':') != std::string::npos) {
+				mapkeyinterval = (u_int)strtoul(value.c_str() + value.find(':') + 1, NULL, 10);
+			}
+		}
+		else if (key == "mapfloor")
+		{
+			// mapfloor=kPa: pads below this count as unloaded in the maps and compress away
+			mapfloorkPa = (float)strtod(value.c_str(), NULL);
+		}
+		else if (key == "rate")
+		{
+			// rate=Hz: at most this many packets a second
+			sendrate = strtod(value.c_str(), NULL);
+		}
+		else if (key == "subscribe")
+		{
+			// subscribe=address:port[:Hz]: every packet also goes to address (a multicast group works too), at most Hz a second
+			char address[64];
+			u_int port = 0;
+			double hz = 0;
+			if (sscanf(value.c_str(), "%63[^:]:%u:%lf", address, &port, &hz) < 2 || !tacts[0]->addsubscriber(address, port, hz)) {
+				printf("Ignoring handshake option %s.\n", words[w].c_str());
+				continue;
+			}
+		}
+		else if (key == "heartbeat")
+		{
+			// heartbeat=ms: the receiver sends a heartbeat this often, without HEARTBEATMISSES of them streaming stops until it handshakes again
+			heartbeatms = (u_int)strtoul(value.c_str(), NULL, 10);
 		}
-		updateandsend(*tact1, *tact2, presbuftosend1, presbuftosend2);
+		else if (key == "stats")
+		{
+			// stats=port: the stage timings go to this port of the receiver too
+			statsport = (u_int)strtoul(value.c_str(), NULL, 10);
+		}
+		else
+		{
+			printf("Ignoring handshake option %s.\n", words[w].c_str());
+		}
+	}
+
+	if (tactilus_udp::packetFieldCount(sendfields) > MAXFIELDS)
+	{
+		printf("Can't send %u quantities per sensor, at most %d fit in a packet.\n", tactilus_udp::packetFieldCount(sendfields), MAXFIELDS);
+		return false;
+	}
+
+	printf("Sending %u quantities (fields 0x%x) for %u sensors", tactilus_udp::packetFieldCount(sendfields), sendfields, numsensreq);
+	if (sendrate > 0) {
+		printf(" at most %.0f times a second", sendrate);
+	}
+	if (sendmap) {
+		printf(" with pressure maps (keyframe every %u)", mapkeyinterval);
+	}
+	printf(", filters");
+	for (u_int i = 0; i < numsensreq; ++i)
+	{
+		printf(" %s", tacts[i]->getfiltername());
 	}
+	printf(".\n");
+	return true;
+}
 
+int main(int argc, char** argv)
+	//  testTwoSensors [synthetic [address]]
+	//  synthetic sends a generated walk instead of reading insoles (always the case without the Tactilus SDK), address replaces SERVER
+{
+#ifdef _WIN32
+	synthetic = argc > 1 && strcmp(argv[1], "synthetic") == 0;
+#else
+	synthetic = true;
+#endif
+	if (argc > 2) {
+		server = argv[2];
+	}
+	if (synthetic) {
+		printf("Sending synthetic gait to %s.\n", server);
+	}
+
+	std::vector<tactilus_udp::TactilusUDP*> opened; // every sensor opened so far, opened[0] does the talking
+	opened.push_back(opensensor(0, 1));
+	std::vector<tactilus_udp::TactilusUDP*> tacts;
+	for (;;)
+	{
+		// Handshaking until a reply can be served, then streaming until the receiver asks for something else or goes away
+		std::string reply = handshake(opened[0]);
+		while (!reply.empty() && configure(reply, opened, tacts))
+		{
+			reply = updateandsend(tacts, reply);
+		}
+	}
 	return 0;
 }